@@ -0,0 +1,468 @@
+/*********************************************************************
+*
+* File      : bench.c
+*
+* Author    : Barry Kimelman
+*
+* Created   : October 19, 2026
+*
+* Purpose   : Functions shared by the benchmark harnesses lcbench and
+*             cfbench : timing , process control , system call counting
+*             and generation of test entries.
+*
+*********************************************************************/
+
+#include	<stdio.h>
+#include	<sys/types.h>
+#include	<sys/stat.h>
+#include	<sys/time.h>
+#include	<sys/resource.h>
+#include	<sys/wait.h>
+#include	<sys/ptrace.h>
+#include	<string.h>
+#include	<stdlib.h>
+#include	<unistd.h>
+#include	<stdarg.h>
+#include	<signal.h>
+#include	<fcntl.h>
+#include	<time.h>
+#include	"bench.h"
+
+int		bench_debug = 0;
+
+extern	void	quit();
+
+/*********************************************************************
+*
+* Function  : debug_print
+*
+* Purpose   : Display an optional debugging message.
+*
+* Inputs    : char *format - the format string (ala printf)
+*             ... - the data values for the format string
+*
+* Output    : the debugging message
+*
+* Returns   : nothing
+*
+* Example   : debug_print("The answer is %s\n",answer);
+*
+* Notes     : Messages are only shown when bench_debug is set.
+*
+*********************************************************************/
+
+void debug_print(char *format,...)
+{
+	va_list ap;
+
+	if ( bench_debug ) {
+		va_start(ap,format);
+		vfprintf(stdout, format, ap);
+		fflush(stdout);
+		va_end(ap);
+	} /* IF debug mode is on */
+
+	return;
+} /* end of debug_print */
+
+/*********************************************************************
+*
+* Function  : now_seconds
+*
+* Purpose   : Get the current value of the monotonic clock.
+*
+* Inputs    : (none)
+*
+* Output    : (none)
+*
+* Returns   : time in seconds
+*
+* Example   : start = now_seconds();
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+double now_seconds()
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+
+	return(ts.tv_sec + ts.tv_nsec / 1e9);
+} /* end of now_seconds */
+
+/*********************************************************************
+*
+* Function  : compare_doubles
+*
+* Purpose   : Compare two doubles for qsort().
+*
+* Inputs    : ptr1 - pointer to first value
+*             ptr2 - pointer to second value
+*
+* Output    : (none)
+*
+* Returns   : <0 , 0 , >0
+*
+* Example   : qsort(times,count,sizeof(double),compare_doubles);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+int compare_doubles(const void *ptr1, const void *ptr2)
+{
+	double	value1 , value2;
+
+	value1 = *(double *)ptr1;
+	value2 = *(double *)ptr2;
+
+	return( (value1 > value2) - (value1 < value2) );
+} /* end of compare_doubles */
+
+/*********************************************************************
+*
+* Function  : read_marker
+*
+* Purpose   : Get the number of entries recorded for previously
+*             generated test data.
+*
+* Inputs    : path - name of the marker file
+*
+* Output    : (none)
+*
+* Returns   : number of entries , -1 if there is no marker
+*
+* Example   : count = read_marker(path);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+long read_marker(char *path)
+{
+	FILE	*fp;
+	long	count;
+
+	fp = fopen(path,"r");
+	if ( fp == NULL ) {
+		return(-1);
+	} /* IF */
+	if ( fscanf(fp,"%ld",&count) != 1 ) {
+		count = -1;
+	} /* IF */
+	fclose(fp);
+
+	return(count);
+} /* end of read_marker */
+
+/*********************************************************************
+*
+* Function  : write_marker
+*
+* Purpose   : Record the number of entries of generated test data.
+*
+* Inputs    : path - name of the marker file
+*             count - number of entries
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : write_marker(path,count);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void write_marker(char *path, long count)
+{
+	FILE	*fp;
+
+	fp = fopen(path,"w");
+	if ( fp == NULL ) {
+		quit(1,"fopen failed for \"%s\"",path);
+	} /* IF */
+	fprintf(fp,"%ld\n",count);
+	fclose(fp);
+
+	return;
+} /* end of write_marker */
+
+/*********************************************************************
+*
+* Function  : make_entry
+*
+* Purpose   : Create one directory entry of the specified kind.
+*
+* Inputs    : dir_fd - descriptor of the directory
+*             name - name of the entry
+*             kind - 0 to 19
+*
+* Output    : (none)
+*
+* Returns   : 1 if a subdirectory was created , else 0
+*
+* Example   : if ( make_entry(dir_fd,name,random() % 20) ) ...
+*
+* Notes     : Kinds 0 to 13 are regular files (0 is executable) , 14
+*             and 15 subdirectories , 16 and 17 symbolic links , 18 a
+*             FIFO and 19 a socket. So kind = count % 20 gives 70%
+*             files (1 in 14 of them , about 7% , executable) , 10%
+*             subdirectories , 10% links , 5% FIFOs and 5% sockets.
+*
+*********************************************************************/
+
+int make_entry(int dir_fd, char *name, int kind)
+{
+	int		fd;
+
+	if ( kind < 14 ) {
+		fd = openat(dir_fd,name,O_WRONLY | O_CREAT | O_EXCL,(kind == 0) ? 0755 : 0644);
+		if ( fd < 0 ) {
+			quit(1,"create failed for \"%s\"",name);
+		} /* IF */
+		close(fd);
+	} /* IF */
+	else if ( kind < 16 ) {
+		if ( mkdirat(dir_fd,name,0755) < 0 ) {
+			quit(1,"mkdir failed for \"%s\"",name);
+		} /* IF */
+		return(1);
+	} /* ELSE IF */
+	else if ( kind < 18 ) {
+		if ( symlinkat("target_of_link",dir_fd,name) < 0 ) {
+			quit(1,"symlink failed for \"%s\"",name);
+		} /* IF */
+	} /* ELSE IF */
+	else if ( kind == 18 ) {
+		if ( mkfifoat(dir_fd,name,0644) < 0 ) {
+			quit(1,"mkfifo failed for \"%s\"",name);
+		} /* IF */
+	} /* ELSE IF */
+	else {
+		if ( mknodat(dir_fd,name,S_IFSOCK | 0644,0) < 0 ) {
+			quit(1,"mknod failed for \"%s\"",name);
+		} /* IF */
+	} /* ELSE */
+
+	return(0);
+} /* end of make_entry */
+
+/*********************************************************************
+*
+* Function  : build_args
+*
+* Purpose   : Build the argument list for running the benchmarked
+*             command.
+*
+* Inputs    : args - array of MAX_ARGS to receive the arguments
+*             program - path of the command
+*             fixed - options given on every run , separated by blanks
+*             combo - options under test , separated by blanks
+*             buffer - buffer to hold the split options
+*             dirname - directory to be processed
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : build_args(args,lc_path,"-C 80",combo,buffer,dirname);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void build_args(char *args[], char *program, char *fixed, char *combo, char *buffer,
+				char *dirname)
+{
+	int		num_args;
+	char	*token;
+
+	num_args = 0;
+	args[num_args++] = program;
+	sprintf(buffer,"%s %s",fixed,combo);
+	for ( token = strtok(buffer," \t") ; token != NULL && num_args < MAX_ARGS - 2 ;
+				token = strtok(NULL," \t") ) {
+		args[num_args++] = token;
+	} /* FOR */
+	args[num_args++] = dirname;
+	args[num_args] = NULL;
+
+	return;
+} /* end of build_args */
+
+/*********************************************************************
+*
+* Function  : start_program
+*
+* Purpose   : Start the benchmarked command as a child process.
+*
+* Inputs    : args - argument list
+*             traced - non-zero if the child is to be traced
+*             out_fd - descriptor to receive its output , -1 to
+*                      discard it
+*
+* Output    : (none)
+*
+* Returns   : process id of child
+*
+* Example   : pid = start_program(args,0,-1);
+*
+* Notes     : A traced child stops itself before the exec so that the
+*             tracing options can be set. Error messages are always
+*             discarded.
+*
+*********************************************************************/
+
+pid_t start_program(char *args[], int traced, int out_fd)
+{
+	pid_t	pid;
+	int		fd;
+
+	fflush(stdout);
+	pid = fork();
+	if ( pid < 0 ) {
+		quit(1,"fork failed");
+	} /* IF */
+	if ( pid == 0 ) {
+		fd = open("/dev/null",O_WRONLY);
+		if ( fd >= 0 ) {
+			dup2((out_fd >= 0) ? out_fd : fd,1);
+			dup2(fd,2);
+			close(fd);
+		} /* IF */
+		if ( traced ) {
+			ptrace(PTRACE_TRACEME,0,NULL,NULL);
+			raise(SIGSTOP);
+		} /* IF */
+		execv(args[0],args);
+		_exit(127);
+	} /* IF */
+
+	return(pid);
+} /* end of start_program */
+
+/*********************************************************************
+*
+* Function  : time_program
+*
+* Purpose   : Run the benchmarked command once and measure it.
+*
+* Inputs    : args - argument list
+*             peak_rss - pointer to receive peak RSS in Kb
+*             handler - function called with each line of output ,
+*                       NULL to discard the output
+*             context - passed on to handler
+*
+* Output    : (none)
+*
+* Returns   : wall time in seconds , -1 if the command failed
+*
+* Example   : elapsed = time_program(args,&peak_rss,NULL,NULL);
+*
+* Notes     : The output is read through a pipe while the command
+*             runs , so the time includes reading it.
+*
+*********************************************************************/
+
+double time_program(char *args[], long *peak_rss, void (*handler)(char *line, void *context),
+					void *context)
+{
+	pid_t	pid;
+	int		status , pipe_fds[2];
+	double	start , elapsed;
+	struct rusage	usage;
+	FILE	*fp;
+	char	line[1024];
+
+	start = now_seconds();
+	if ( handler == NULL ) {
+		pid = start_program(args,0,-1);
+	} /* IF */
+	else {
+		if ( pipe(pipe_fds) < 0 ) {
+			quit(1,"pipe failed");
+		} /* IF */
+		pid = start_program(args,0,pipe_fds[1]);
+		close(pipe_fds[1]);
+		fp = fdopen(pipe_fds[0],"r");
+		if ( fp == NULL ) {
+			quit(1,"fdopen failed");
+		} /* IF */
+		while ( fgets(line,sizeof(line),fp) != NULL ) {
+			(*handler)(line,context);
+		} /* WHILE */
+		fclose(fp);
+	} /* ELSE */
+	if ( wait4(pid,&status,0,&usage) < 0 ) {
+		quit(1,"wait4 failed");
+	} /* IF */
+	elapsed = now_seconds() - start;
+	*peak_rss = usage.ru_maxrss;
+	if ( ! WIFEXITED(status) || WEXITSTATUS(status) != 0 ) {
+		return(-1.0);
+	} /* IF */
+
+	return(elapsed);
+} /* end of time_program */
+
+/*********************************************************************
+*
+* Function  : count_syscalls
+*
+* Purpose   : Run the benchmarked command once under ptrace and count
+*             its system calls.
+*
+* Inputs    : args - argument list
+*
+* Output    : (none)
+*
+* Returns   : number of system calls made by all threads , -1 on error
+*
+* Example   : count = count_syscalls(args);
+*
+* Notes     : Every system call produces an entry stop and an exit stop ,
+*             so the number of stops is halved. Threads are followed
+*             through PTRACE_O_TRACECLONE.
+*
+*********************************************************************/
+
+long count_syscalls(char *args[])
+{
+	pid_t	pid , tid;
+	int		status , sig;
+	long	stops;
+
+	pid = start_program(args,1,-1);
+	if ( waitpid(pid,&status,0) < 0 || ! WIFSTOPPED(status) ) {
+		return(-1);
+	} /* IF */
+	ptrace(PTRACE_SETOPTIONS,pid,NULL,
+			(void *)(PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE |
+			PTRACE_O_EXITKILL));
+	ptrace(PTRACE_SYSCALL,pid,NULL,NULL);
+
+	stops = 0;
+	while ( (tid = waitpid(-1,&status,__WALL)) > 0 ) {
+		if ( WIFEXITED(status) || WIFSIGNALED(status) ) {
+			if ( tid == pid ) {
+				break;
+			} /* IF */
+			continue;
+		} /* IF */
+		sig = 0;
+		if ( WIFSTOPPED(status) ) {
+			if ( WSTOPSIG(status) == (SIGTRAP | 0x80) ) {
+				stops += 1;
+			} /* IF */
+			else if ( WSTOPSIG(status) != SIGTRAP && WSTOPSIG(status) != SIGSTOP ) {
+				sig = WSTOPSIG(status);
+			} /* ELSE IF */
+		} /* IF */
+		ptrace(PTRACE_SYSCALL,tid,NULL,(void *)(long)sig);
+	} /* WHILE */
+
+	return((stops + 1) / 2);
+} /* end of count_syscalls */
@@ -0,0 +1,36 @@
+/*********************************************************************
+*
+* File      : bench.h
+*
+* Author    : Barry Kimelman
+*
+* Created   : October 19, 2026
+*
+* Purpose   : Declarations of the functions shared by the benchmark
+*             harnesses (see bench.c).
+*
+*********************************************************************/
+
+#ifndef	BENCH_H
+#define	BENCH_H
+
+#include	<sys/types.h>
+
+#define	MAX_ARGS		64		/* most arguments of a benchmarked command */
+
+extern	int		bench_debug;
+
+extern	void	debug_print(char *format,...);
+extern	double	now_seconds(void);
+extern	int		compare_doubles(const void *ptr1, const void *ptr2);
+extern	long	read_marker(char *path);
+extern	void	write_marker(char *path, long count);
+extern	int		make_entry(int dir_fd, char *name, int kind);
+extern	void	build_args(char *args[], char *program, char *fixed, char *combo,
+					char *buffer, char *dirname);
+extern	pid_t	start_program(char *args[], int traced, int out_fd);
+extern	double	time_program(char *args[], long *peak_rss,
+					void (*handler)(char *line, void *context), void *context);
+extern	long	count_syscalls(char *args[]);
+
+#endif
@@ -0,0 +1,781 @@
+/*********************************************************************
+*
+* File      : cfbench.c
+*
+* Author    : Barry Kimelman
+*
+* Created   : October 19, 2026
+*
+* Purpose   : Benchmark the "countfiles" command against generated
+*             directory trees of different shapes.
+*
+*********************************************************************/
+
+#include	<stdio.h>
+#include	<sys/types.h>
+#include	<sys/stat.h>
+#include	<sys/param.h>
+#include	<sys/wait.h>
+#include	<dirent.h>
+#include	<string.h>
+#include	<stdlib.h>
+#include	<unistd.h>
+#include	<fcntl.h>
+#include	<errno.h>
+#include	"bench.h"
+
+#define	EQ(s1,s2)	(strcmp(s1,s2)==0)
+
+#define	MAX_COMBOS		64
+#define	MAX_REPEATS		100
+#define	MAX_MIX_ENTRIES	64		/* most entries directly in a "mix" directory */
+#define	MARKER_SUFFIX	".done"	/* records the size of a generated tree */
+#define	DEF_DEEP_LEVELS	1500	/* fits in MAXPATHLEN below most base_dirs */
+
+#define	TREE_WIDE	1
+#define	TREE_DEEP	2
+#define	TREE_MIX	4
+
+static	char	*progname = NULL;
+static	char	*cf_path = "./countfiles";
+static	int		opt_k = 0 , opt_s = 0;
+static	int		num_repeats = 3;
+static	int		tree_types = TREE_WIDE | TREE_DEEP | TREE_MIX;
+
+static	long	wide_files = 1000000;
+static	int		wide_fanout = 100;
+static	long	deep_levels = DEF_DEEP_LEVELS;
+static	long	mix_entries = 100000;
+
+static	char	*combos[MAX_COMBOS] = { "" , "-T 4" , "-T 16" , "-s" , "-s -U" ,
+					"-s -T 4" , "-s -U -T 4" };
+static	int		num_combos = 7;
+static	int		combos_given = 0;
+
+static	char	*stems[] = { "data" , "Report" , "x" , "build_output_file" ,
+					"IMG" , "notes" , "a_rather_long_file_name_for_testing" };
+
+extern	void	die() , quit() , system_error();
+
+/*********************************************************************
+*
+* Function  : usage
+*
+* Purpose   : Display program usage message.
+*
+* Inputs    : (none)
+*
+* Output    : Program usage message.
+*
+* Returns   : (nothing)
+*
+* Example   : usage();
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void usage()
+{
+	fprintf(stderr,"Usage : %s [-dks] [-c countfiles_path] [-t trees] [-n wide_files] "
+			"[-f fanout]\n          [-D deep_levels] [-m mix_entries] "
+			"[-o countfiles_options] [-r repeats] base_dir [base_dir ...]\n",progname);
+	fprintf(stderr,"  -d  debug mode\n");
+	fprintf(stderr,"  -k  keep the generated trees\n");
+	fprintf(stderr,"  -s  also count system calls (traced run , not timed)\n");
+	fprintf(stderr,"  -t  trees to test , any of wide,deep,mix (default all)\n");
+	fprintf(stderr,"  -n  files in the wide tree (default 1000000)\n");
+	fprintf(stderr,"  -f  fanout of the wide tree (default 100)\n");
+	fprintf(stderr,"  -D  levels of the deep chain (default %d)\n",DEF_DEEP_LEVELS);
+	fprintf(stderr,"  -m  entries in the mixed tree (default 100000)\n");
+	fprintf(stderr,"  -o  countfiles options to test (repeatable)\n");
+	fprintf(stderr,"Use a tmpfs (eg. /dev/shm) and a disk filesystem as the base_dirs.\n");
+
+	return;
+} /* end of usage */
+
+/*********************************************************************
+*
+* Function  : remove_entries
+*
+* Purpose   : Remove everything inside a directory.
+*
+* Inputs    : dir_fd - descriptor of the directory , which is closed
+*
+* Output    : (none)
+*
+* Returns   : a new descriptor of the same directory
+*
+* Example   : dir_fd = remove_entries(dir_fd);
+*
+* Notes     : The descriptor of a directory is closed while its
+*             subdirectories are emptied and reopened through ".."
+*             afterwards , so even the deepest chain needs only two
+*             descriptors at a time. Paths are never built.
+*
+*********************************************************************/
+
+int remove_entries(int dir_fd)
+{
+	DIR		*dirptr;
+	struct dirent	*entry;
+	char	**subdirs;
+	int		num_subdirs , max_subdirs , index , child_fd;
+
+	dirptr = fdopendir(dup(dir_fd));
+	if ( dirptr == NULL ) {
+		quit(1,"fdopendir failed");
+	} /* IF */
+	subdirs = NULL;
+	num_subdirs = 0;
+	max_subdirs = 0;
+	while ( (entry = readdir(dirptr)) != NULL ) {
+		if ( EQ(entry->d_name,".") || EQ(entry->d_name,"..") ) {
+			continue;
+		} /* IF */
+		if ( unlinkat(dir_fd,entry->d_name,0) < 0 && (errno == EISDIR || errno == EPERM) ) {
+			if ( num_subdirs >= max_subdirs ) {
+				max_subdirs = max_subdirs * 2 + 16;
+				subdirs = (char **)realloc(subdirs,max_subdirs * sizeof(char *));
+				if ( subdirs == NULL ) {
+					quit(1,"realloc failed for subdirectory names");
+				} /* IF */
+			} /* IF */
+			subdirs[num_subdirs++] = strdup(entry->d_name);
+		} /* IF */
+	} /* WHILE */
+	closedir(dirptr);
+
+	for ( index = 0 ; index < num_subdirs ; ++index ) {
+		child_fd = openat(dir_fd,subdirs[index],O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+		if ( child_fd >= 0 ) {
+			close(dir_fd);
+			child_fd = remove_entries(child_fd);
+			dir_fd = openat(child_fd,"..",O_RDONLY | O_DIRECTORY);
+			if ( dir_fd < 0 ) {
+				quit(1,"open failed for \"..\"");
+			} /* IF */
+			close(child_fd);
+		} /* IF */
+		if ( unlinkat(dir_fd,subdirs[index],AT_REMOVEDIR) < 0 ) {
+			system_error("rmdir failed for \"%s\"",subdirs[index]);
+		} /* IF */
+		free(subdirs[index]);
+	} /* FOR */
+	free(subdirs);
+
+	return(dir_fd);
+} /* end of remove_entries */
+
+/*********************************************************************
+*
+* Function  : remove_tree
+*
+* Purpose   : Remove a generated tree and its marker.
+*
+* Inputs    : dirname - name of the top directory of the tree
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : remove_tree(dirname);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void remove_tree(char *dirname)
+{
+	char	path[MAXPATHLEN];
+	int		dir_fd;
+
+	snprintf(path,sizeof(path),"%s%s",dirname,MARKER_SUFFIX);
+	unlink(path);
+	dir_fd = open(dirname,O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+	if ( dir_fd < 0 ) {
+		return;
+	} /* IF */
+	close(remove_entries(dir_fd));
+	if ( rmdir(dirname) < 0 ) {
+		system_error("rmdir failed for \"%s\"",dirname);
+	} /* IF */
+
+	return;
+} /* end of remove_tree */
+
+/*********************************************************************
+*
+* Function  : generate_wide
+*
+* Purpose   : Fill a directory with a balanced tree of regular files.
+*
+* Inputs    : dir_fd - descriptor of the directory
+*             num_files - number of files below the directory
+*
+* Output    : (none)
+*
+* Returns   : number of entries created , directories included
+*
+* Example   : count = generate_wide(dir_fd,1000000);
+*
+* Notes     : Every directory has up to wide_fanout entries and the
+*             files are all in the bottom level.
+*
+*********************************************************************/
+
+long generate_wide(int dir_fd, long num_files)
+{
+	char	name[NAME_MAX+1];
+	long	count , share;
+	int		index , child_fd;
+
+	count = 0;
+	if ( num_files <= wide_fanout ) {
+		for ( index = 0 ; index < num_files ; ++index ) {
+			snprintf(name,sizeof(name),"%s_%d",stems[index % 7],index);
+			make_entry(dir_fd,name,1);
+		} /* FOR */
+		return(num_files);
+	} /* IF bottom level */
+
+	for ( index = 0 ; index < wide_fanout ; ++index ) {
+		share = num_files / wide_fanout + (index < num_files % wide_fanout);
+		snprintf(name,sizeof(name),"dir_%d",index);
+		make_entry(dir_fd,name,14);
+		child_fd = openat(dir_fd,name,O_RDONLY | O_DIRECTORY);
+		if ( child_fd < 0 ) {
+			quit(1,"open failed for \"%s\"",name);
+		} /* IF */
+		count += 1 + generate_wide(child_fd,share);
+		close(child_fd);
+	} /* FOR */
+
+	return(count);
+} /* end of generate_wide */
+
+/*********************************************************************
+*
+* Function  : generate_deep
+*
+* Purpose   : Fill a directory with a chain of nested directories.
+*
+* Inputs    : dir_fd - descriptor of the directory , which is closed
+*             num_levels - number of levels
+*
+* Output    : (none)
+*
+* Returns   : number of entries created , directories included
+*
+* Example   : count = generate_deep(dir_fd,1500);
+*
+* Notes     : Each level holds one file and the next level. main()
+*             only asks for chains whose paths fit in MAXPATHLEN , as
+*             countfiles could not traverse a deeper one.
+*
+*********************************************************************/
+
+long generate_deep(int dir_fd, long num_levels)
+{
+	long	level , count;
+	int		child_fd;
+
+	count = 0;
+	for ( level = 0 ; level < num_levels ; ++level ) {
+		make_entry(dir_fd,"file",1);
+		count += 1;
+		if ( level + 1 < num_levels ) {
+			count += make_entry(dir_fd,"d",14);
+			child_fd = openat(dir_fd,"d",O_RDONLY | O_DIRECTORY);
+			if ( child_fd < 0 ) {
+				quit(1,"open failed at level %ld",level + 1);
+			} /* IF */
+			close(dir_fd);
+			dir_fd = child_fd;
+		} /* IF */
+	} /* FOR */
+	close(dir_fd);
+
+	return(count);
+} /* end of generate_deep */
+
+/*********************************************************************
+*
+* Function  : generate_mix
+*
+* Purpose   : Fill a directory with an irregular tree of mixed types.
+*
+* Inputs    : dir_fd - descriptor of the directory
+*             num_entries - number of entries below the directory
+*
+* Output    : (none)
+*
+* Returns   : number of entries created
+*
+* Example   : count = generate_mix(dir_fd,100000);
+*
+* Notes     : Each directory gets a random number of entries , whose
+*             types are mixed as described in make_entry(). The rest
+*             of the entries are shared out among
+*             the subdirectories with random weights , so the tree has
+*             both crowded and sparse branches.
+*
+*********************************************************************/
+
+long generate_mix(int dir_fd, long num_entries)
+{
+	char	name[NAME_MAX+1] , **subdirs;
+	long	count , remaining , share , weights[MAX_MIX_ENTRIES + 1] , total_weight;
+	int		num_here , num_subdirs , index , child_fd;
+
+	num_here = 1 + random() % MAX_MIX_ENTRIES;
+	if ( num_here > num_entries ) {
+		num_here = num_entries;
+	} /* IF */
+	subdirs = (char **)calloc(num_here + 1,sizeof(char *));
+	if ( subdirs == NULL ) {
+		quit(1,"calloc failed for subdirectory names");
+	} /* IF */
+	num_subdirs = 0;
+	for ( index = 0 ; index < num_here ; ++index ) {
+		snprintf(name,sizeof(name),"%s_%d%s",stems[random() % 7],index,
+					(index % 3 == 0) ? ".txt" : "");
+		if ( make_entry(dir_fd,name,random() % 20) ) {
+			subdirs[num_subdirs++] = strdup(name);
+		} /* IF */
+	} /* FOR */
+	count = num_here;
+	remaining = num_entries - num_here;
+	if ( remaining > 0 && num_subdirs == 0 ) {
+		make_entry(dir_fd,"more",14);
+		subdirs[num_subdirs++] = strdup("more");
+		count += 1;
+		remaining -= 1;
+	} /* IF the rest must go somewhere */
+
+	total_weight = 0;
+	for ( index = 0 ; index < num_subdirs ; ++index ) {
+		weights[index] = 1 + random() % 1000;
+		total_weight += weights[index];
+	} /* FOR */
+	for ( index = 0 ; index < num_subdirs ; ++index ) {
+		share = (index == num_subdirs - 1) ? remaining :
+					remaining * weights[index] / total_weight;
+		if ( share > 0 ) {
+			child_fd = openat(dir_fd,subdirs[index],O_RDONLY | O_DIRECTORY);
+			if ( child_fd < 0 ) {
+				quit(1,"open failed for \"%s\"",subdirs[index]);
+			} /* IF */
+			count += generate_mix(child_fd,share);
+			close(child_fd);
+		} /* IF */
+		remaining -= share;
+		total_weight -= weights[index];
+		free(subdirs[index]);
+	} /* FOR */
+	free(subdirs);
+
+	return(count);
+} /* end of generate_mix */
+
+/*********************************************************************
+*
+* Function  : generate_tree
+*
+* Purpose   : Create a tree of the specified type.
+*
+* Inputs    : dirname - name of the top directory of the tree
+*             tree_type - TREE_WIDE , TREE_DEEP or TREE_MIX
+*
+* Output    : progress message
+*
+* Returns   : number of entries in the tree
+*
+* Example   : count = generate_tree("/dev/shm/cfbench.deep.1500",TREE_DEEP);
+*
+* Notes     : An existing tree with a marker is reused. The generators
+*             are seeded so that a tree is the same every time.
+*
+*********************************************************************/
+
+long generate_tree(char *dirname, int tree_type)
+{
+	char	path[MAXPATHLEN];
+	long	count;
+	int		dir_fd;
+	double	start;
+
+	snprintf(path,sizeof(path),"%s%s",dirname,MARKER_SUFFIX);
+	count = read_marker(path);
+	if ( count >= 0 ) {
+		debug_print("Reuse %s\n",dirname);
+		return(count);
+	} /* IF */
+	remove_tree(dirname);
+	if ( mkdir(dirname,0755) < 0 ) {
+		quit(1,"mkdir failed for \"%s\"",dirname);
+	} /* IF */
+	dir_fd = open(dirname,O_RDONLY | O_DIRECTORY);
+	if ( dir_fd < 0 ) {
+		quit(1,"open failed for \"%s\"",dirname);
+	} /* IF */
+
+	printf("Generating %s ...",dirname);
+	fflush(stdout);
+	start = now_seconds();
+	srandom(1);
+	switch ( tree_type ) {
+	case TREE_WIDE:
+		count = generate_wide(dir_fd,wide_files);
+		close(dir_fd);
+		break;
+	case TREE_DEEP:
+		count = generate_deep(dir_fd,deep_levels);
+		break;
+	default:
+		count = generate_mix(dir_fd,mix_entries);
+		close(dir_fd);
+	} /* SWITCH */
+	write_marker(path,count);
+	printf(" %ld entries , %.1f seconds\n",count,now_seconds() - start);
+
+	return(count);
+} /* end of generate_tree */
+
+/*********************************************************************
+*
+* Function  : count_line
+*
+* Purpose   : Add up the counts in a line of countfiles output.
+*
+* Inputs    : line - the line
+*             context - pointer to the running number of entries
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : elapsed = time_program(args,&peak_rss,count_line,&num_counted);
+*
+* Notes     : The counts of all the classes are added up , a Total
+*             line is skipped.
+*
+*********************************************************************/
+
+void count_line(char *line, void *context)
+{
+	char	*bracket;
+
+	bracket = strchr(line,'[');
+	if ( bracket != NULL && strncmp(line,"Total",5) != 0 ) {
+		*(long *)context += atol(bracket + 1);
+	} /* IF */
+
+	return;
+} /* end of count_line */
+
+/*********************************************************************
+*
+* Function  : check_missing_root
+*
+* Purpose   : Check that countfiles fails for a directory which does
+*             not exist.
+*
+* Inputs    : base_dir - directory in which the missing name is made up
+*
+* Output    : result of the check
+*
+* Returns   : 1 if the check passed , else 0
+*
+* Example   : check_missing_root(argv[optind]);
+*
+* Notes     : Unreadable directories are counted rather than being
+*             fatal , so the exit status is the only sign of them.
+*
+*********************************************************************/
+
+int check_missing_root(char *base_dir)
+{
+	char	*args[MAX_ARGS] , buffer[1024] , dirname[MAXPATHLEN];
+	pid_t	pid;
+	int		status;
+
+	snprintf(dirname,sizeof(dirname),"%s/cfbench.missing.%d",base_dir,(int)getpid());
+	build_args(args,cf_path,"","",buffer,dirname);
+	pid = start_program(args,0,-1);
+	if ( waitpid(pid,&status,0) < 0 ) {
+		quit(1,"waitpid failed");
+	} /* IF */
+	if ( WIFEXITED(status) && WEXITSTATUS(status) == 1 ) {
+		printf("Missing directory check    ok\n");
+		return(1);
+	} /* IF */
+	printf("Missing directory check    FAILED , countfiles did not exit with status 1\n");
+
+	return(0);
+} /* end of check_missing_root */
+
+/*********************************************************************
+*
+* Function  : run_benchmark
+*
+* Purpose   : Time all the countfiles option combinations against one
+*             generated tree.
+*
+* Inputs    : dirname - name of the top directory of the tree
+*             num_entries - number of entries in the tree
+*
+* Output    : one report line per option combination
+*
+* Returns   : (nothing)
+*
+* Example   : run_benchmark("/dev/shm/cfbench.mix.100000",100000);
+*
+* Notes     : The rate is for the median run. A run which reports a
+*             different number of entries than were generated is
+*             flagged , since a fast wrong answer is not an improvement.
+*
+*********************************************************************/
+
+void run_benchmark(char *dirname, long num_entries)
+{
+	char	*args[MAX_ARGS] , buffer[1024] , syscalls[32] , check[32];
+	double	times[MAX_REPEATS] , elapsed;
+	long	peak_rss , max_rss , count , num_counted;
+	int		combo , repeat , failed;
+
+	printf("\n%s [%ld entries]\n",dirname,num_entries);
+	printf("%-20s %10s %10s %12s %10s %10s  %s\n","countfiles options","min (s)",
+				"median (s)","entries/s","peak RSS Kb",opt_s ? "calls/entry" : "","check");
+	for ( combo = 0 ; combo < num_combos ; ++combo ) {
+		build_args(args,cf_path,"",combos[combo],buffer,dirname);
+		max_rss = 0;
+		failed = 0;
+		for ( repeat = 0 ; repeat < num_repeats ; ++repeat ) {
+			num_counted = 0;
+			elapsed = time_program(args,&peak_rss,count_line,&num_counted);
+			if ( elapsed < 0 ) {
+				failed = 1;
+				break;
+			} /* IF */
+			times[repeat] = elapsed;
+			if ( peak_rss > max_rss ) {
+				max_rss = peak_rss;
+			} /* IF */
+		} /* FOR */
+		if ( failed ) {
+			printf("%-20s countfiles failed\n",combos[combo][0] ? combos[combo] : "(none)");
+			continue;
+		} /* IF */
+		qsort(times,num_repeats,sizeof(double),compare_doubles);
+		syscalls[0] = '\0';
+		if ( opt_s ) {
+			count = count_syscalls(args);
+			snprintf(syscalls,sizeof(syscalls),"%.2f",(double)count / num_entries);
+		} /* IF */
+		if ( num_counted == num_entries ) {
+			strcpy(check,"ok");
+		} /* IF */
+		else {
+			snprintf(check,sizeof(check),"counted %ld",num_counted);
+		} /* ELSE */
+		printf("%-20s %10.4f %10.4f %12.0f %10ld %10s  %s\n",
+				combos[combo][0] ? combos[combo] : "(none)",times[0],
+				times[num_repeats / 2],num_entries / times[num_repeats / 2],
+				max_rss,syscalls,check);
+	} /* FOR */
+
+	return;
+} /* end of run_benchmark */
+
+/*********************************************************************
+*
+* Function  : parse_trees
+*
+* Purpose   : Convert a list of tree names into a set of tree types.
+*
+* Inputs    : list - names separated by commas
+*
+* Output    : (none)
+*
+* Returns   : tree types , 0 if a name is not known
+*
+* Example   : tree_types = parse_trees("wide,mix");
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+int parse_trees(char *list)
+{
+	char	buffer[256] , *token;
+	int		types;
+
+	types = 0;
+	snprintf(buffer,sizeof(buffer),"%s",list);
+	for ( token = strtok(buffer,",") ; token != NULL ; token = strtok(NULL,",") ) {
+		if ( EQ(token,"wide") ) {
+			types |= TREE_WIDE;
+		} /* IF */
+		else if ( EQ(token,"deep") ) {
+			types |= TREE_DEEP;
+		} /* ELSE IF */
+		else if ( EQ(token,"mix") ) {
+			types |= TREE_MIX;
+		} /* ELSE IF */
+		else {
+			return(0);
+		} /* ELSE */
+	} /* FOR */
+
+	return(types);
+} /* end of parse_trees */
+
+/*********************************************************************
+*
+* Function  : main
+*
+* Purpose   : Benchmark countfiles against generated trees.
+*
+* Inputs    : int argc - number of arguments
+*             char *argv[] - list of arguments
+*
+* Output    : benchmark report
+*
+* Returns   : 0 --> success , 1 --> error
+*
+* Example   : cfbench -s -c ./countfiles /dev/shm /var/tmp
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+int main(int argc, char *argv[])
+{
+	int		c , errors , base , tree_type;
+	char	dirname[MAXPATHLEN];
+	long	num_entries;
+
+	progname = argv[0];
+	errors = 0;
+	while ( (c = getopt(argc,argv,":dksc:t:n:f:D:m:o:r:")) != EOF ) {
+		switch ( c ) {
+		case 'd':
+			bench_debug = 1;
+			break;
+		case 'k':
+			opt_k = 1;
+			break;
+		case 's':
+			opt_s = 1;
+			break;
+		case 'c':
+			cf_path = optarg;
+			break;
+		case 't':
+			tree_types = parse_trees(optarg);
+			if ( tree_types == 0 ) {
+				fprintf(stderr,"Trees must be a list of wide , deep and mix\n");
+				errors += 1;
+			} /* IF */
+			break;
+		case 'n':
+			wide_files = atol(optarg);
+			if ( wide_files < 1 ) {
+				fprintf(stderr,"Number of files must be at least 1\n");
+				errors += 1;
+			} /* IF */
+			break;
+		case 'f':
+			wide_fanout = atoi(optarg);
+			if ( wide_fanout < 2 ) {
+				fprintf(stderr,"Fanout must be at least 2\n");
+				errors += 1;
+			} /* IF */
+			break;
+		case 'D':
+			deep_levels = atol(optarg);
+			if ( deep_levels < 1 ) {
+				fprintf(stderr,"Number of levels must be at least 1\n");
+				errors += 1;
+			} /* IF */
+			break;
+		case 'm':
+			mix_entries = atol(optarg);
+			if ( mix_entries < 1 ) {
+				fprintf(stderr,"Number of entries must be at least 1\n");
+				errors += 1;
+			} /* IF */
+			break;
+		case 'o':
+			if ( ! combos_given ) {
+				num_combos = 0;
+				combos_given = 1;
+			} /* IF */
+			if ( num_combos >= MAX_COMBOS ) {
+				die(1,"Too many option combinations , limit is %d\n",MAX_COMBOS);
+			} /* IF */
+			combos[num_combos++] = optarg;
+			break;
+		case 'r':
+			num_repeats = atoi(optarg);
+			if ( num_repeats < 1 || num_repeats > MAX_REPEATS ) {
+				fprintf(stderr,"Repeats must be between 1 and %d\n",MAX_REPEATS);
+				errors += 1;
+			} /* IF */
+			break;
+		case '?':
+			fprintf(stderr,"Unknown option '%c'\n",optopt);
+			errors += 1;
+			break;
+		case ':':
+			fprintf(stderr,"Missing value for option '%c'\n",optopt);
+			errors += 1;
+			break;
+		} /* SWITCH */
+	} /* WHILE over optional args */
+	if ( errors || optind >= argc ) {
+		usage();
+		exit(1);
+	} /* IF */
+	if ( access(cf_path,X_OK) < 0 ) {
+		quit(1,"Can't execute \"%s\"",cf_path);
+	} /* IF */
+	if ( ! check_missing_root(argv[optind]) ) {
+		exit(1);
+	} /* IF */
+
+	for ( base = optind ; base < argc ; ++base ) {
+		for ( tree_type = TREE_WIDE ; tree_type <= TREE_MIX ; tree_type <<= 1 ) {
+			if ( (tree_types & tree_type) == 0 ) {
+				continue;
+			} /* IF */
+			switch ( tree_type ) {
+			case TREE_WIDE:
+				snprintf(dirname,sizeof(dirname),"%s/cfbench.wide.%ld.%d",argv[base],
+							wide_files,wide_fanout);
+				break;
+			case TREE_DEEP:
+				snprintf(dirname,sizeof(dirname),"%s/cfbench.deep.%ld",argv[base],
+							deep_levels);
+				/* the deepest path is dirname followed by "/d" per level and "/file" */
+				if ( strlen(dirname) + 2 * (deep_levels - 1) + 5 >= MAXPATHLEN ) {
+					printf("\n%s [%ld levels]\nnot supported , its paths would be "
+							"longer than MAXPATHLEN (%d)\n",dirname,deep_levels,MAXPATHLEN);
+					continue;
+				} /* IF */
+				break;
+			default:
+				snprintf(dirname,sizeof(dirname),"%s/cfbench.mix.%ld",argv[base],
+							mix_entries);
+			} /* SWITCH */
+			num_entries = generate_tree(dirname,tree_type);
+			run_benchmark(dirname,num_entries);
+			if ( ! opt_k ) {
+				remove_tree(dirname);
+			} /* IF */
+		} /* FOR over tree types */
+	} /* FOR over base directories */
+
+	exit(0);
+} /* end of main */
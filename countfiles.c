@@ -21,11 +21,57 @@
 #include	<stdarg.h>
 #include	<libgen.h>
 #include	<strings.h>
+#include	<pthread.h>
+#include	<fcntl.h>
+#include	<ctype.h>
+#include	<time.h>
+#include	<sys/mman.h>
+#include	<sys/inotify.h>
+#include	<sys/socket.h>
+#include	<sys/un.h>
+#include	<poll.h>
+#include	<signal.h>
+#include	<errno.h>
+#include	<fnmatch.h>
+#include	<math.h>
+#include	<sys/syscall.h>
+#include	<sys/sysmacros.h>
+#include	<linux/io_uring.h>
+#include	<linux/stat.h>
 
 #define	LT(s1,s2)	(strcasecmp(s1,s2)<0)
 #define	GT(s1,s2)	(strcasecmp(s1,s2)>0)
 #define	EQ(s1,s2)	(strcmp(s1,s2)==0)
-#define	MAX_DIRS	1024
+#define	MAX_THREADS	256
+#define	MAX_SKIP_PATTERNS	64
+#define	MAX_ERRNO		256		/* errno values counted individually */
+#define	MAX_SLOWEST		10		/* slowest directories reported by -S */
+#define	CACHE_LINE_SIZE	64
+#define	INIT_INODE_SET_SIZE	1024	/* must be a power of 2 */
+#define	INIT_DEQUE_SIZE	64
+#define	INIT_EXT_TABLE_SIZE	256	/* must be a power of 2 */
+#define	ARENA_CHUNK_SIZE	65536
+#define	MAX_EXT_LEN		16		/* longer suffixes are not treated as extensions */
+#define	NUM_SIZE_BUCKETS	8
+#define	NUM_CLASSES		8
+#define	SNAPSHOT_MAGIC	"CFSNAP01"
+#define	SNAPSHOT_RACY_SECS	2	/* newer mtimes may not reflect a following change */
+#define	INIT_SNAPBUF_SIZE	65536
+#define	WATCH_EVENTS	(IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+				IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+#define	EVENT_BUFFER_SIZE	65536
+#define	DEF_MAX_SAMPLES	1000	/* subtrees sampled by -a */
+#define	DEF_MAX_SECS	5		/* time budget of -a */
+#define	INIT_FRONTIER_SIZE	1024
+#define	RING_ENTRIES	64		/* statx requests in flight per thread (-U) */
+#define	RING_SUBMIT_BATCH	16	/* requests queued before they are submitted */
+#define	SETTLE_MSECS	10	/* quiet time before unpaired moves and recounts are resolved */
+
+typedef struct classcounts {
+	int		num_entries;
+	long long	total_size;		/* sum of st_size */
+	long long	total_blocks;	/* sum of st_blocks (512 byte units) */
+} __attribute__ ((aligned (CACHE_LINE_SIZE))) CLASSCOUNTS;	/* one per thread */
 
 typedef	struct fileclass {
 	char	*class_title;
@@ -33,8 +79,184 @@ typedef	struct fileclass {
 	int		longest_name;
 	char	**classnames;
 	int		max_entries;
+	CLASSCOUNTS	*thread_counts;	/* per root and thread , merged by merge_counts() */
+	long long	total_size;
+	long long	total_blocks;
 } FILECLASS;
 
+typedef struct extslot {
+	char	*extension;		/* key stored in the table's arena , NULL if slot empty */
+	unsigned int	hash;
+	int		num_files;
+	long long	total_bytes;
+	int		buckets[NUM_SIZE_BUCKETS];	/* file counts by size bucket */
+} EXTSLOT;
+
+typedef struct arenachunk {
+	struct arenachunk	*next;
+	int		used;
+	char	data[ARENA_CHUNK_SIZE];
+} ARENACHUNK;
+
+typedef struct exttable {
+	EXTSLOT	*slots;
+	unsigned int	size;
+	unsigned int	count;
+	ARENACHUNK	*arena;
+} EXTTABLE;	/* one per thread , merged by merge_extensions() */
+
+typedef struct snapheader {
+	char	magic[8];
+	long long	data_size;		/* bytes of records following the header */
+} SNAPHEADER;
+
+typedef struct snaprecord {
+	unsigned long long	dev;
+	unsigned long long	ino;
+	long long	mtime_sec;
+	long long	mtime_nsec;		/* -1 if the directory must be read next time */
+	int		num_entries[NUM_CLASSES];	/* entries directly in the directory */
+	int		num_subdirs;
+	int		names_size;		/* bytes of subdirectory names following , padded to 8 */
+} SNAPRECORD;
+
+typedef struct snapbuf {
+	char	*data;
+	size_t	used;
+	size_t	size;
+} SNAPBUF;	/* one per thread , records of the new snapshot */
+
+typedef struct inodekey {
+	dev_t	dev;
+	ino_t	ino;		/* 0 marks an empty slot */
+} INODEKEY;
+
+typedef struct inodeset {
+	INODEKEY	*slots;		/* open addressing hash table */
+	unsigned long	size;		/* a power of 2 */
+	unsigned long	count;
+	pthread_mutex_t	lock;
+} INODESET;
+
+typedef struct special {
+	struct special	*next;
+	int		class_index;
+	char	name[1];
+} SPECIAL;	/* a watched entry which is neither a regular file nor a directory */
+
+typedef struct watchdir {
+	struct watchdir	*parent;
+	struct watchdir	*children;
+	struct watchdir	*next_sibling;
+	char	*name;		/* name within the parent , the path of the root */
+	int		wd;			/* inotify watch descriptor , -1 if none */
+	int		num_entries[NUM_CLASSES];	/* entries directly in the directory */
+	SPECIAL	*specials;
+	int		depth;		/* 0 for the top directory */
+	int		dirty;		/* must be recounted once the events settle */
+	struct watchdir	*next_dirty;
+} WATCHDIR;
+
+typedef struct slowdir {
+	double	secs;
+	char	*path;
+} SLOWDIR;
+
+typedef struct threadstats {
+	unsigned long	num_dirs;		/* read by the progress thread */
+	unsigned long	num_entries;	/* read by the progress thread */
+	unsigned long	num_stats;
+	double	opendir_secs;
+	double	readdir_secs;
+	double	stat_secs;
+	int		errors[MAX_ERRNO];
+	SLOWDIR	slowest[MAX_SLOWEST];	/* min-heap on secs */
+	int		num_slowest;
+} __attribute__ ((aligned (CACHE_LINE_SIZE))) THREADSTATS;	/* one per thread */
+
+typedef struct estimate {
+	double	mean;		/* running mean of the sampled subtree counts */
+	double	sum_squares;	/* sum of squared deviations from the mean */
+} ESTIMATE;	/* one per class plus one for the total (-a) */
+
+typedef struct dirnode {
+	struct dirnode	*parent;
+	int		pending;	/* the directory itself plus its unfinished subdirectories */
+	long	direct;		/* entries directly in the directory */
+	long	recursive;	/* entries in the whole subtree */
+	char	path[1];
+} DIRNODE;	/* a directory whose subtree is still being counted (-D) */
+
+typedef struct heavydir {
+	long	count;
+	char	*path;
+} HEAVYDIR;
+
+typedef struct heavyheap {
+	HEAVYDIR	*dirs;		/* min-heap on count */
+	int		count;
+} __attribute__ ((aligned (CACHE_LINE_SIZE))) HEAVYHEAP;	/* two per thread */
+
+typedef struct dirscan {
+	char	*dirname;
+	int		dir_fd;
+	int		thread_num;
+	int		root;		/* index of the root it was found under */
+	int		slot;		/* index of the class counters to update */
+	WATCHDIR	*watch;		/* node of the directory in watch mode , else NULL */
+	DIRNODE	*node;		/* node of the directory for -D , else NULL */
+	int		depth;
+	SNAPRECORD	record;		/* snapshot record being built (-i) */
+	char	*names;		/* subdirectory names following the record */
+	size_t	names_used;
+	size_t	names_size;
+} DIRSCAN;	/* state of the directory being read by process_dir() */
+
+typedef struct statslot {
+	struct statx	stx;
+	mode_t	filemode;	/* type from readdir() , used if statx fails */
+	char	name[NAME_MAX + 1];
+} STATSLOT;
+
+typedef struct statring {
+	int		fd;
+	unsigned	*sq_head;
+	unsigned	*sq_tail;
+	unsigned	sq_mask;
+	unsigned	*sq_array;
+	struct io_uring_sqe	*sqes;
+	unsigned	*cq_head;
+	unsigned	*cq_tail;
+	unsigned	cq_mask;
+	struct io_uring_cqe	*cqes;
+	int		to_submit;		/* queued but not yet submitted */
+	int		num_free;
+	int		free_slots[RING_ENTRIES];
+	STATSLOT	slots[RING_ENTRIES];
+} STATRING;	/* one per thread (-U) */
+
+typedef struct workitem {
+	WATCHDIR	*watch;		/* node of the directory in watch mode , else NULL */
+	DIRNODE	*node;		/* node of the directory for -D , else NULL */
+	int		root;		/* index of the root it was found under */
+	int		depth;		/* 0 for the top directory */
+	char	path[1];
+} WORKITEM;
+
+typedef struct workdeque {
+	pthread_mutex_t	lock;
+	WORKITEM	**items;	/* directories waiting in slots [top,bottom) */
+	int		top;
+	int		bottom;
+	int		capacity;
+} WORKDEQUE;
+
+typedef struct worker {
+	pthread_t	thread;
+	int		thread_num;
+	WORKDEQUE	deque;
+} WORKER;
+
 int		init_names_size = 100 , increment_names_size = 25;
 
 FILECLASS regular_class = { "Regular Files" , 0 , 0 , NULL };
@@ -46,184 +268,3833 @@ FILECLASS symlink_class = { "Symbolic Links" , 0 , 0 , NULL };
 FILECLASS socket_class = { "Sockets" , 0 , 0 , NULL };
 FILECLASS misc_class = { "Miscellaneous" , 0 , 0 , NULL };
 
-FILECLASS	*class_list[] = { &regular_class , &dir_class , &char_class ,
-			&block_class , &pipe_class , &symlink_class , &socket_class ,
-			&misc_class };
-int		num_classes = sizeof(class_list) / sizeof(FILECLASS *);
+FILECLASS total_class = { "Total" , 0 , 0 , NULL };
+
+FILECLASS	*class_list[NUM_CLASSES] = { &regular_class , &dir_class , &char_class ,
+			&block_class , &pipe_class , &symlink_class , &socket_class ,
+			&misc_class };
+int		num_classes = sizeof(class_list) / sizeof(FILECLASS *);
+
+int	opt_d = 0 , opt_h = 0 , opt_s = 0 , opt_e = 0 , opt_b = 0 , opt_i = 0 , opt_w = 0;
+int		opt_L = 0;
+int		top_n = 10;
+int		opt_x = 0 , max_depth = -1 , num_skip_patterns = 0 , opt_p = 0 , opt_S = 0;
+char	*skip_patterns[MAX_SKIP_PATTERNS];
+int		num_roots = 1;
+char	*default_root = ".";
+char	**root_paths = &default_root;	/* directories named on the command line */
+dev_t	*root_devs = NULL;		/* device of each root (-x) */
+char	*progname;
+int		num_threads = 1 , threads_given = 0;
+
+WORKER	*workers = NULL;
+THREADSTATS	*thread_stats = NULL;
+char	current_path[MAXPATHLEN];	/* shown by the progress line */
+pthread_mutex_t	progress_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t	progress_cond = PTHREAD_COND_INITIALIZER;
+int		progress_done = 0;
+int		approx_levels = -1 , max_samples = DEF_MAX_SAMPLES;
+double	max_secs = DEF_MAX_SECS;
+int		collect_frontier = 0;	/* set while the top levels are enumerated */
+char	**frontier = NULL;		/* subtrees below the enumerated levels */
+int		frontier_count = 0 , frontier_size = 0 , num_samples = 0;
+pthread_mutex_t	frontier_lock = PTHREAD_MUTEX_INITIALIZER;
+ESTIMATE	estimates[NUM_CLASSES + 1];
+int		opt_U = 0;
+STATRING	*stat_rings = NULL;		/* NULL if the entries are stat'ed one at a time */
+int		heavy_n = 0;		/* number of heaviest directories reported (-D) */
+HEAVYHEAP	*heavy_direct = NULL , *heavy_recursive = NULL;		/* one per thread , NULL without -D */
+int		top_counts[NUM_CLASSES];	/* exact counts of the enumerated levels */
+pthread_mutex_t	work_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t	work_cond = PTHREAD_COND_INITIALIZER;
+int		pending_dirs = 0;		/* directories queued or being scanned */
+int		idle_workers = 0;
+unsigned long	work_generation = 0;	/* bumped whenever a directory is queued */
+
+INODESET	link_set = { NULL , 0 , 0 , PTHREAD_MUTEX_INITIALIZER };	/* multiply-linked files already totalled */
+INODESET	visited_set = { NULL , 0 , 0 , PTHREAD_MUTEX_INITIALIZER };	/* directories already read (-L) */
+
+EXTTABLE	*ext_tables = NULL;
+char	*snapshot_path = NULL;
+char	*snapshot_map = NULL;		/* previous snapshot */
+size_t	snapshot_size = 0;
+SNAPRECORD	**snapshot_index = NULL;	/* previous records hashed by (dev,inode) */
+unsigned long	snapshot_index_size = 0;
+SNAPBUF	*snap_buffers = NULL;
+
+char	*socket_path = NULL;
+int		inotify_fd = -1;
+WATCHDIR	*watch_root = NULL;
+WATCHDIR	*dirty_list = NULL;		/* directories waiting for recount_dir() */
+WATCHDIR	**watch_table = NULL;	/* nodes indexed by watch descriptor */
+int		watch_table_size = 0;
+pthread_mutex_t	watch_lock = PTHREAD_MUTEX_INITIALIZER;
+volatile sig_atomic_t	stop_watching = 0;
+
+char	*bucket_titles[NUM_SIZE_BUCKETS] = { "0" , "<1K" , "<16K" , "<256K" ,
+				"<4M" , "<64M" , "<1G" , ">=1G" };
+
+extern	int	optind , optopt , opterr;
+extern	void	system_error() , die() , quit();
+
+void	queue_dir(int thread_num, char *dirname, WATCHDIR *watch, DIRNODE *parent, int root,
+				int depth);
+
+/*********************************************************************
+*
+* Function  : usage
+*
+* Purpose   : Display a brief help summary
+*
+* Inputs    : (none)
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : usage()
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void usage()
+{
+	fprintf(stderr,"Usage : %s [-dhsebxpSUL] [-n top_n] [-i snapshot_file] [-w socket_path] [-m max_depth]\n"
+			"          [-X skip_glob] [-T num_threads] [-a levels] [-c max_samples] [-t max_secs]\n"
+			"          [-D num_dirs] [dirname ...]\n",progname);
+
+	return;
+} /* end of usage */
+
+/*********************************************************************
+*
+* Function  : inode_hash
+*
+* Purpose   : Compute the hash value of a (device,inode) pair.
+*
+* Inputs    : dev - device number
+*             ino - inode number
+*
+* Output    : (none)
+*
+* Returns   : hash value
+*
+* Example   : hash = inode_hash(filestats.st_dev,filestats.st_ino);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+unsigned long inode_hash(dev_t dev, ino_t ino)
+{
+	unsigned long long	hash;
+
+	hash = (unsigned long long)ino ^ ((unsigned long long)dev << 40);
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+
+	return((unsigned long)hash);
+} /* end of inode_hash */
+
+/*********************************************************************
+*
+* Function  : add_inode
+*
+* Purpose   : Add a (device,inode) pair to a set , determining if it is
+*             being seen for the first time.
+*
+* Inputs    : set - the set
+*             dev - device number
+*             ino - inode number
+*
+* Output    : (none)
+*
+* Returns   : 1 if the pair had not been seen before , else 0
+*
+* Example   : if ( add_inode(&link_set,filestats.st_dev,filestats.st_ino) ) ...
+*
+* Notes     : The pairs are kept in an open addressing hash table of
+*             16 byte slots which is doubled when half full. Used for
+*             the multiply-linked files of -s and the directories of -L.
+*
+*********************************************************************/
+
+int add_inode(INODESET *set, dev_t dev, ino_t ino)
+{
+	INODEKEY	*old_slots;
+	unsigned long	old_size , index , slot , mask;
+	int		first;
+
+	pthread_mutex_lock(&set->lock);
+	if ( set->count * 2 >= set->size ) {
+		old_slots = set->slots;
+		old_size = set->size;
+		set->size = old_size ? old_size * 2 : INIT_INODE_SET_SIZE;
+		set->slots = (INODEKEY *)calloc(set->size,sizeof(INODEKEY));
+		if ( set->slots == NULL ) {
+			quit(1,"calloc failed for inode set of %lu slots",set->size);
+		} /* IF */
+		mask = set->size - 1;
+		for ( index = 0 ; index < old_size ; ++index ) {
+			if ( old_slots[index].ino != 0 ) {
+				slot = inode_hash(old_slots[index].dev,old_slots[index].ino) & mask;
+				while ( set->slots[slot].ino != 0 ) {
+					slot = (slot + 1) & mask;
+				} /* WHILE */
+				set->slots[slot] = old_slots[index];
+			} /* IF */
+		} /* FOR over old slots */
+		free(old_slots);
+	} /* IF table must grow */
+
+	mask = set->size - 1;
+	slot = inode_hash(dev,ino) & mask;
+	first = 1;
+	while ( set->slots[slot].ino != 0 ) {
+		if ( set->slots[slot].ino == ino && set->slots[slot].dev == dev ) {
+			first = 0;
+			break;
+		} /* IF */
+		slot = (slot + 1) & mask;
+	} /* WHILE */
+	if ( first ) {
+		set->slots[slot].dev = dev;
+		set->slots[slot].ino = ino;
+		set->count += 1;
+	} /* IF */
+	pthread_mutex_unlock(&set->lock);
+
+	return(first);
+} /* end of add_inode */
+
+/*********************************************************************
+*
+* Function  : arena_copy
+*
+* Purpose   : Copy a string into the key arena of an extension table.
+*
+* Inputs    : table - pointer to extension table
+*             string - string to be copied
+*             length - length of string
+*
+* Output    : (none)
+*
+* Returns   : pointer to the copy
+*
+* Example   : key = arena_copy(table,extension,length);
+*
+* Notes     : Keys are never freed individually , so they are packed
+*             into large chunks instead of being malloc'ed one by one.
+*
+*********************************************************************/
+
+char *arena_copy(EXTTABLE *table, char *string, int length)
+{
+	ARENACHUNK	*chunk;
+	char	*copy;
+
+	chunk = table->arena;
+	if ( chunk == NULL || chunk->used + length + 1 > ARENA_CHUNK_SIZE ) {
+		chunk = (ARENACHUNK *)malloc(sizeof(ARENACHUNK));
+		if ( chunk == NULL ) {
+			quit(1,"malloc failed for key arena");
+		} /* IF */
+		chunk->next = table->arena;
+		chunk->used = 0;
+		table->arena = chunk;
+	} /* IF a new chunk is needed */
+	copy = &chunk->data[chunk->used];
+	memcpy(copy,string,length);
+	copy[length] = '\0';
+	chunk->used += length + 1;
+
+	return(copy);
+} /* end of arena_copy */
+
+/*********************************************************************
+*
+* Function  : find_extension
+*
+* Purpose   : Find the slot for an extension , adding it if necessary.
+*
+* Inputs    : table - pointer to extension table
+*             extension - the extension
+*             length - length of extension
+*             hash - hash value of extension
+*
+* Output    : (none)
+*
+* Returns   : pointer to slot
+*
+* Example   : slot = find_extension(table,"txt",3,hash);
+*
+* Notes     : Open addressing with linear probing , the table is
+*             doubled when it becomes 3/4 full.
+*
+*********************************************************************/
+
+EXTSLOT *find_extension(EXTTABLE *table, char *extension, int length, unsigned int hash)
+{
+	EXTSLOT	*old_slots , *slot;
+	unsigned int	old_size , index , mask;
+
+	if ( (table->count + 1) * 4 > table->size * 3 ) {
+		old_slots = table->slots;
+		old_size = table->size;
+		table->size = old_size ? old_size * 2 : INIT_EXT_TABLE_SIZE;
+		table->slots = (EXTSLOT *)calloc(table->size,sizeof(EXTSLOT));
+		if ( table->slots == NULL ) {
+			quit(1,"calloc failed for extension table of %u slots",table->size);
+		} /* IF */
+		mask = table->size - 1;
+		for ( index = 0 ; index < old_size ; ++index ) {
+			if ( old_slots[index].extension != NULL ) {
+				slot = &table->slots[old_slots[index].hash & mask];
+				while ( slot->extension != NULL ) {
+					slot = &table->slots[(slot - table->slots + 1) & mask];
+				} /* WHILE */
+				*slot = old_slots[index];
+			} /* IF */
+		} /* FOR over old slots */
+		free(old_slots);
+	} /* IF table must grow */
+
+	mask = table->size - 1;
+	slot = &table->slots[hash & mask];
+	while ( slot->extension != NULL ) {
+		if ( slot->hash == hash && strncmp(slot->extension,extension,length) == 0 &&
+						slot->extension[length] == '\0' ) {
+			return(slot);
+		} /* IF */
+		slot = &table->slots[(slot - table->slots + 1) & mask];
+	} /* WHILE */
+	slot->extension = arena_copy(table,extension,length);
+	slot->hash = hash;
+	table->count += 1;
+
+	return(slot);
+} /* end of find_extension */
+
+/*********************************************************************
+*
+* Function  : size_bucket
+*
+* Purpose   : Determine the size bucket of a file.
+*
+* Inputs    : size - file size in bytes
+*
+* Output    : (none)
+*
+* Returns   : bucket index
+*
+* Example   : bucket = size_bucket(filestats.st_size);
+*
+* Notes     : Each bucket after the first two is 16 times larger than
+*             the previous one , see bucket_titles[].
+*
+*********************************************************************/
+
+int size_bucket(long long size)
+{
+	int		bucket;
+	long long	limit;
+
+	if ( size == 0 ) {
+		return(0);
+	} /* IF */
+	for ( bucket = 1 , limit = 1024 ; bucket < NUM_SIZE_BUCKETS - 1 ; ++bucket , limit *= 16 ) {
+		if ( size < limit ) {
+			break;
+		} /* IF */
+	} /* FOR */
+
+	return(bucket);
+} /* end of size_bucket */
+
+/*********************************************************************
+*
+* Function  : add_extension
+*
+* Purpose   : Tally a regular file under its extension.
+*
+* Inputs    : thread_num - number of the thread doing the counting
+*             filename - unqualified filename
+*             size - file size in bytes
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : add_extension(thread_num,entry->d_name,filestats.st_size);
+*
+* Notes     : The extension follows the last '.' of the name and is
+*             folded to lower case. Names without one (or with a dot
+*             only at the start) are tallied under the empty string ,
+*             which no real extension can match , and reported as
+*             "(none)".
+*
+*********************************************************************/
+
+void add_extension(int thread_num, char *filename, long long size)
+{
+	char	extension[MAX_EXT_LEN+1] , *dot;
+	int		length;
+	unsigned int	hash;
+	EXTSLOT	*slot;
+
+	dot = strrchr(filename,'.');
+	length = 0;
+	if ( dot != NULL && dot != filename ) {
+		for ( ++dot ; *dot && length < MAX_EXT_LEN ; ++dot ) {
+			extension[length++] = tolower((unsigned char)*dot);
+		} /* FOR */
+		if ( *dot ) {
+			length = 0;
+		} /* IF too long to be an extension */
+	} /* IF */
+
+	hash = 2166136261U;
+	for ( dot = extension ; dot < &extension[length] ; ++dot ) {
+		hash = (hash ^ (unsigned char)*dot) * 16777619U;
+	} /* FOR */
+	slot = find_extension(&ext_tables[thread_num],extension,length,hash);
+	slot->num_files += 1;
+	slot->total_bytes += size;
+	slot->buckets[size_bucket(size)] += 1;
+
+	return;
+} /* end of add_extension */
+
+/*********************************************************************
+*
+* Function  : merge_extensions
+*
+* Purpose   : Merge the extension tables of all the threads into the
+*             table of thread 0.
+*
+* Inputs    : (none)
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : merge_extensions();
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void merge_extensions()
+{
+	int		thread_num , bucket;
+	unsigned int	index;
+	EXTSLOT	*from , *to;
+
+	for ( thread_num = 1 ; thread_num < num_threads ; ++thread_num ) {
+		for ( index = 0 ; index < ext_tables[thread_num].size ; ++index ) {
+			from = &ext_tables[thread_num].slots[index];
+			if ( from->extension == NULL ) {
+				continue;
+			} /* IF */
+			to = find_extension(&ext_tables[0],from->extension,strlen(from->extension),
+							from->hash);
+			to->num_files += from->num_files;
+			to->total_bytes += from->total_bytes;
+			for ( bucket = 0 ; bucket < NUM_SIZE_BUCKETS ; ++bucket ) {
+				to->buckets[bucket] += from->buckets[bucket];
+			} /* FOR */
+		} /* FOR over slots */
+	} /* FOR over threads */
+
+	return;
+} /* end of merge_extensions */
+
+/*********************************************************************
+*
+* Function  : compare_by_count
+*
+* Purpose   : Compare two extension slots for qsort() , most files first.
+*
+* Inputs    : ptr1 - pointer to first slot pointer
+*             ptr2 - pointer to second slot pointer
+*
+* Output    : (none)
+*
+* Returns   : <0 , 0 , >0
+*
+* Example   : qsort(list,count,sizeof(EXTSLOT *),compare_by_count);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+int compare_by_count(const void *ptr1, const void *ptr2)
+{
+	EXTSLOT	*slot1 , *slot2;
+
+	slot1 = *(EXTSLOT **)ptr1;
+	slot2 = *(EXTSLOT **)ptr2;
+	if ( slot1->num_files != slot2->num_files ) {
+		return( (slot1->num_files < slot2->num_files) ? 1 : -1 );
+	} /* IF */
+
+	return(strcmp(slot1->extension,slot2->extension));
+} /* end of compare_by_count */
+
+/*********************************************************************
+*
+* Function  : compare_by_bytes
+*
+* Purpose   : Compare two extension slots for qsort() , most bytes first.
+*
+* Inputs    : ptr1 - pointer to first slot pointer
+*             ptr2 - pointer to second slot pointer
+*
+* Output    : (none)
+*
+* Returns   : <0 , 0 , >0
+*
+* Example   : qsort(list,count,sizeof(EXTSLOT *),compare_by_bytes);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+int compare_by_bytes(const void *ptr1, const void *ptr2)
+{
+	EXTSLOT	*slot1 , *slot2;
+
+	slot1 = *(EXTSLOT **)ptr1;
+	slot2 = *(EXTSLOT **)ptr2;
+	if ( slot1->total_bytes != slot2->total_bytes ) {
+		return( (slot1->total_bytes < slot2->total_bytes) ? 1 : -1 );
+	} /* IF */
+
+	return(strcmp(slot1->extension,slot2->extension));
+} /* end of compare_by_bytes */
+
+/*********************************************************************
+*
+* Function  : dump_extensions
+*
+* Purpose   : Display the top extensions by number of files and by
+*             number of bytes.
+*
+* Inputs    : (none)
+*
+* Output    : extension histogram
+*
+* Returns   : (nothing)
+*
+* Example   : dump_extensions();
+*
+* Notes     : With -b the file counts of each size bucket are shown.
+*
+*********************************************************************/
+
+void dump_extensions()
+{
+	EXTSLOT	**list;
+	EXTTABLE	*table;
+	unsigned int	index , count , limit , pass , bucket;
+
+	merge_extensions();
+	table = &ext_tables[0];
+	list = (EXTSLOT **)malloc((table->count + 1) * sizeof(EXTSLOT *));
+	if ( list == NULL ) {
+		quit(1,"malloc failed for extension list");
+	} /* IF */
+	count = 0;
+	for ( index = 0 ; index < table->size ; ++index ) {
+		if ( table->slots[index].extension != NULL ) {
+			list[count++] = &table->slots[index];
+		} /* IF */
+	} /* FOR */
+	limit = (count < top_n) ? count : top_n;
+
+	for ( pass = 0 ; pass < 2 ; ++pass ) {
+		qsort(list,count,sizeof(EXTSLOT *),pass ? compare_by_bytes : compare_by_count);
+		printf("\nTop %u extensions by %s\n",limit,pass ? "bytes" : "number of files");
+		printf("%-16s %10s %16s","extension","files","bytes");
+		if ( opt_b ) {
+			for ( bucket = 0 ; bucket < NUM_SIZE_BUCKETS ; ++bucket ) {
+				printf(" %8s",bucket_titles[bucket]);
+			} /* FOR */
+		} /* IF */
+		printf("\n");
+		for ( index = 0 ; index < limit ; ++index ) {
+			printf("%-16s %10d %16lld",
+					list[index]->extension[0] ? list[index]->extension : "(none)",
+					list[index]->num_files,
+					list[index]->total_bytes);
+			if ( opt_b ) {
+				for ( bucket = 0 ; bucket < NUM_SIZE_BUCKETS ; ++bucket ) {
+					printf(" %8d",list[index]->buckets[bucket]);
+				} /* FOR */
+			} /* IF */
+			printf("\n");
+		} /* FOR */
+	} /* FOR over sort orders */
+	free(list);
+
+	return;
+} /* end of dump_extensions */
+
+/*********************************************************************
+*
+* Function  : count_slot
+*
+* Purpose   : Find the class counters of a thread for a root.
+*
+* Inputs    : root - index of the root
+*             thread_num - number of the thread
+*
+* Output    : (none)
+*
+* Returns   : index into the thread_counts of every class
+*
+* Example   : scan.slot = count_slot(root,thread_num);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+int count_slot(int root, int thread_num)
+{
+	return(root * num_threads + thread_num);
+} /* end of count_slot */
+
+/*********************************************************************
+*
+* Function  : add_to_class
+*
+* Purpose   : Add an entry to the specified class.
+*
+* Inputs    : class_ptr - pointer to class structure
+*             slot - index of the counters , see count_slot()
+*             filestats - pointer to status of entry , NULL if the
+*                         disk usage is not being totalled
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : add_to_class(&dir_class,scan->slot,&filestats);
+*
+* Notes     : Each thread updates its own counters , see merge_counts().
+*             Every name is counted but the space of a multiply-linked
+*             file is only totalled for the first link found.
+*
+*********************************************************************/
+
+void add_to_class(FILECLASS *class_ptr, int slot, struct stat *filestats)
+{
+	CLASSCOUNTS	*counts;
+
+	counts = &class_ptr->thread_counts[slot];
+	counts->num_entries += 1;
+	if ( filestats != NULL ) {
+		if ( filestats->st_nlink > 1 && ! S_ISDIR(filestats->st_mode) &&
+					! add_inode(&link_set,filestats->st_dev,filestats->st_ino) ) {
+			return;
+		} /* IF another link to this file was already totalled */
+		counts->total_size += filestats->st_size;
+		counts->total_blocks += filestats->st_blocks;
+	} /* IF */
+
+	return;
+} /* end of add_to_class */
+
+/*********************************************************************
+*
+* Function  : dtype_to_mode
+*
+* Purpose   : Convert a d_type value from readdir() into the matching
+*             S_IFMT file type bits.
+*
+* Inputs    : d_type - type reported by readdir()
+*
+* Output    : (none)
+*
+* Returns   : file type bits , 0 if the type is not known
+*
+* Example   : mode = dtype_to_mode(entry->d_type);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+mode_t dtype_to_mode(unsigned char d_type)
+{
+	switch ( d_type ) {
+	case DT_DIR:
+		return(S_IFDIR);
+	case DT_REG:
+		return(S_IFREG);
+	case DT_BLK:
+		return(S_IFBLK);
+	case DT_CHR:
+		return(S_IFCHR);
+	case DT_FIFO:
+		return(S_IFIFO);
+	case DT_LNK:
+		return(S_IFLNK);
+	case DT_SOCK:
+		return(S_IFSOCK);
+	} /* SWITCH */
+
+	return(0);
+} /* end of dtype_to_mode */
+
+/*********************************************************************
+*
+* Function  : now_secs
+*
+* Purpose   : Get the current value of the monotonic clock.
+*
+* Inputs    : (none)
+*
+* Output    : (none)
+*
+* Returns   : time in seconds
+*
+* Example   : start = now_secs();
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+double now_secs()
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+
+	return(ts.tv_sec + ts.tv_nsec / 1e9);
+} /* end of now_secs */
+
+/*********************************************************************
+*
+* Function  : count_error
+*
+* Purpose   : Count a failed system call by its errno value.
+*
+* Inputs    : thread_num - number of the thread
+*             errcode - the errno value
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : count_error(thread_num,errno);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void count_error(int thread_num, int errcode)
+{
+	if ( errcode <= 0 || errcode >= MAX_ERRNO ) {
+		errcode = 0;
+	} /* IF */
+	thread_stats[thread_num].errors[errcode] += 1;
+
+	return;
+} /* end of count_error */
+
+/*********************************************************************
+*
+* Function  : total_errors
+*
+* Purpose   : Sum the failed system calls of all the threads.
+*
+* Inputs    : (none)
+*
+* Output    : (none)
+*
+* Returns   : number of failed system calls
+*
+* Example   : if ( total_errors() > 0 ) exit(1);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+long total_errors()
+{
+	int		thread_num , index;
+	long	total;
+
+	total = 0;
+	for ( thread_num = 0 ; thread_num < num_threads ; ++thread_num ) {
+		for ( index = 0 ; index < MAX_ERRNO ; ++index ) {
+			total += thread_stats[thread_num].errors[index];
+		} /* FOR */
+	} /* FOR */
+
+	return(total);
+} /* end of total_errors */
+
+/*********************************************************************
+*
+* Function  : open_dir
+*
+* Purpose   : Open a directory , timing the call for -S.
+*
+* Inputs    : dirname - directory name
+*             thread_num - number of the thread
+*
+* Output    : a warning if the directory can't be opened
+*
+* Returns   : directory stream , NULL on error
+*
+* Example   : dirptr = open_dir(dirname,thread_num);
+*
+* Notes     : A directory which can't be opened is reported and
+*             skipped , the rest of the tree is still counted.
+*
+*********************************************************************/
+
+DIR *open_dir(char *dirname, int thread_num)
+{
+	DIR		*dirptr;
+	double	start;
+
+	start = opt_S ? now_secs() : 0;
+	dirptr = opendir(dirname);
+	if ( opt_S ) {
+		thread_stats[thread_num].opendir_secs += now_secs() - start;
+	} /* IF */
+	if ( dirptr == NULL ) {
+		count_error(thread_num,errno);
+		system_error("opendir failed for '%s'",dirname);
+	} /* IF */
+
+	return(dirptr);
+} /* end of open_dir */
+
+/*********************************************************************
+*
+* Function  : read_dir
+*
+* Purpose   : Read the next directory entry , timing the call for -S.
+*
+* Inputs    : dirptr - directory stream
+*             dirname - directory name
+*             thread_num - number of the thread
+*
+* Output    : a warning if the directory can't be read
+*
+* Returns   : entry , NULL at the end of the directory or on error
+*
+* Example   : entry = read_dir(dirptr,dirname,thread_num);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+struct dirent *read_dir(DIR *dirptr, char *dirname, int thread_num)
+{
+	struct dirent	*entry;
+	double	start;
+
+	start = opt_S ? now_secs() : 0;
+	errno = 0;
+	entry = readdir(dirptr);
+	if ( entry == NULL && errno != 0 ) {
+		count_error(thread_num,errno);
+		system_error("readdir failed for '%s'",dirname);
+	} /* IF */
+	if ( opt_S ) {
+		thread_stats[thread_num].readdir_secs += now_secs() - start;
+	} /* IF */
+
+	return(entry);
+} /* end of read_dir */
+
+/*********************************************************************
+*
+* Function  : stat_entry
+*
+* Purpose   : Get the status of a directory entry , timing the call
+*             for -S.
+*
+* Inputs    : dir_fd - descriptor of the directory
+*             dirname - directory name
+*             name - name of the entry
+*             filestats - buffer to receive the status
+*             thread_num - number of the thread
+*
+* Output    : a warning on error
+*
+* Returns   : 0 on success , -1 on error
+*
+* Example   : if ( stat_entry(dir_fd,dirname,entry->d_name,&filestats,thread_num) == 0 ) ...
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+int stat_entry(int dir_fd, char *dirname, char *name, struct stat *filestats, int thread_num)
+{
+	int		status;
+	double	start;
+
+	start = opt_S ? now_secs() : 0;
+	status = fstatat(dir_fd,name,filestats,AT_SYMLINK_NOFOLLOW);
+	if ( opt_S ) {
+		thread_stats[thread_num].stat_secs += now_secs() - start;
+		thread_stats[thread_num].num_stats += 1;
+	} /* IF */
+	if ( status < 0 ) {
+		count_error(thread_num,errno);
+		system_error("fstatat failed for '%s/%s'",dirname,name);
+	} /* IF */
+
+	return(status);
+} /* end of stat_entry */
+
+/*********************************************************************
+*
+* Function  : note_dir_time
+*
+* Purpose   : Record the time taken to scan a directory , keeping the
+*             slowest directories of each thread.
+*
+* Inputs    : thread_num - number of the thread
+*             dirname - directory name
+*             secs - time taken
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : note_dir_time(thread_num,dirname,now_secs() - start);
+*
+* Notes     : The slowest directories are kept in a min-heap so that
+*             the fastest of them is the one replaced.
+*
+*********************************************************************/
+
+void note_dir_time(int thread_num, char *dirname, double secs)
+{
+	THREADSTATS	*stats;
+	SLOWDIR	*heap , temp;
+	int		index , child;
+
+	stats = &thread_stats[thread_num];
+	heap = stats->slowest;
+	if ( stats->num_slowest < MAX_SLOWEST ) {
+		index = stats->num_slowest++;
+		heap[index].secs = secs;
+		heap[index].path = strdup(dirname);
+		if ( heap[index].path == NULL ) {
+			quit(1,"strdup failed for '%s'",dirname);
+		} /* IF */
+		for ( ; index > 0 && heap[(index - 1) / 2].secs > heap[index].secs ;
+					index = (index - 1) / 2 ) {
+			temp = heap[index];
+			heap[index] = heap[(index - 1) / 2];
+			heap[(index - 1) / 2] = temp;
+		} /* FOR sift up */
+		return;
+	} /* IF heap not yet full */
+	if ( secs <= heap[0].secs ) {
+		return;
+	} /* IF */
+	free(heap[0].path);
+	heap[0].secs = secs;
+	heap[0].path = strdup(dirname);
+	if ( heap[0].path == NULL ) {
+		quit(1,"strdup failed for '%s'",dirname);
+	} /* IF */
+	for ( index = 0 ; (child = 2 * index + 1) < MAX_SLOWEST ; index = child ) {
+		if ( child + 1 < MAX_SLOWEST && heap[child + 1].secs < heap[child].secs ) {
+			child += 1;
+		} /* IF */
+		if ( heap[index].secs <= heap[child].secs ) {
+			break;
+		} /* IF */
+		temp = heap[index];
+		heap[index] = heap[child];
+		heap[child] = temp;
+	} /* FOR sift down */
+
+	return;
+} /* end of note_dir_time */
+
+/*********************************************************************
+*
+* Function  : add_frontier
+*
+* Purpose   : Remember a subtree which is to be sampled rather than
+*             enumerated (-a).
+*
+* Inputs    : filepath - path of the subdirectory
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : add_frontier(filepath);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void add_frontier(char *filepath)
+{
+	char	*path;
+
+	path = strdup(filepath);
+	if ( path == NULL ) {
+		quit(1,"strdup failed for '%s'",filepath);
+	} /* IF */
+	pthread_mutex_lock(&frontier_lock);
+	if ( frontier_count >= frontier_size ) {
+		frontier_size = (frontier_size == 0) ? INIT_FRONTIER_SIZE : frontier_size * 2;
+		frontier = (char **)realloc(frontier,frontier_size * sizeof(char *));
+		if ( frontier == NULL ) {
+			quit(1,"realloc failed for %d subtrees",frontier_size);
+		} /* IF */
+	} /* IF */
+	frontier[frontier_count++] = path;
+	pthread_mutex_unlock(&frontier_lock);
+
+	return;
+} /* end of add_frontier */
+
+/*********************************************************************
+*
+* Function  : add_heavy
+*
+* Purpose   : Offer a directory to a heap of the heaviest directories
+*             (-D).
+*
+* Inputs    : heap - heap of the thread
+*             count - number of entries
+*             path - path of the directory
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : add_heavy(&heavy_direct[thread_num],direct,node->path);
+*
+* Notes     : The heap holds at most heavy_n directories with the
+*             lightest at the top , so that memory does not grow with
+*             the size of the tree. The path is only copied if the
+*             directory is kept.
+*
+*********************************************************************/
+
+void add_heavy(HEAVYHEAP *heap, long count, char *path)
+{
+	HEAVYDIR	*dirs , temp;
+	int		index , child;
+
+	dirs = heap->dirs;
+	if ( heap->count < heavy_n ) {
+		index = heap->count++;
+		dirs[index].count = count;
+		dirs[index].path = strdup(path);
+		if ( dirs[index].path == NULL ) {
+			quit(1,"strdup failed for '%s'",path);
+		} /* IF */
+		for ( ; index > 0 && dirs[(index - 1) / 2].count > dirs[index].count ;
+					index = (index - 1) / 2 ) {
+			temp = dirs[index];
+			dirs[index] = dirs[(index - 1) / 2];
+			dirs[(index - 1) / 2] = temp;
+		} /* FOR sift up */
+	} /* IF heap is not full */
+	else if ( count > dirs[0].count ) {
+		free(dirs[0].path);
+		dirs[0].count = count;
+		dirs[0].path = strdup(path);
+		if ( dirs[0].path == NULL ) {
+			quit(1,"strdup failed for '%s'",path);
+		} /* IF */
+		for ( index = 0 ; (child = 2 * index + 1) < heap->count ; index = child ) {
+			if ( child + 1 < heap->count && dirs[child + 1].count < dirs[child].count ) {
+				child += 1;
+			} /* IF */
+			if ( dirs[index].count <= dirs[child].count ) {
+				break;
+			} /* IF */
+			temp = dirs[index];
+			dirs[index] = dirs[child];
+			dirs[child] = temp;
+		} /* FOR sift down */
+	} /* ELSE IF heavier than the lightest kept */
+
+	return;
+} /* end of add_heavy */
+
+/*********************************************************************
+*
+* Function  : new_dir_node
+*
+* Purpose   : Create the -D node of a queued directory.
+*
+* Inputs    : parent - node of the directory which contains it , NULL
+*                      for the top directory
+*             dirname - directory name
+*
+* Output    : (none)
+*
+* Returns   : pointer to new node
+*
+* Example   : item->node = new_dir_node(parent,dirname);
+*
+* Notes     : The parent can't finish until the new node does.
+*
+*********************************************************************/
+
+DIRNODE *new_dir_node(DIRNODE *parent, char *dirname)
+{
+	DIRNODE	*node;
+
+	node = (DIRNODE *)malloc(sizeof(DIRNODE) + strlen(dirname));
+	if ( node == NULL ) {
+		quit(1,"malloc failed for directory node");
+	} /* IF */
+	node->parent = parent;
+	node->pending = 1;
+	node->direct = 0;
+	node->recursive = 0;
+	strcpy(node->path,dirname);
+	if ( parent != NULL ) {
+		__atomic_add_fetch(&parent->pending,1,__ATOMIC_RELAXED);
+	} /* IF */
+
+	return(node);
+} /* end of new_dir_node */
+
+/*********************************************************************
+*
+* Function  : finish_dir_node
+*
+* Purpose   : Record the entries of a directory which has been read and
+*             complete every subtree which that finishes (-D).
+*
+* Inputs    : node - node of the directory
+*             direct - number of entries directly in the directory
+*             thread_num - number of the thread
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : finish_dir_node(node,length,thread_num);
+*
+* Notes     : The thread which finishes the last directory of a subtree
+*             adds the subtree's total to its parent and frees the node ,
+*             so only the nodes of unfinished subtrees are kept.
+*
+*********************************************************************/
+
+void finish_dir_node(DIRNODE *node, long direct, int thread_num)
+{
+	DIRNODE	*parent;
+	long	recursive;
+
+	node->direct = direct;
+	add_heavy(&heavy_direct[thread_num],direct,node->path);
+	__atomic_add_fetch(&node->recursive,direct,__ATOMIC_RELAXED);
+	while ( node != NULL && __atomic_sub_fetch(&node->pending,1,__ATOMIC_ACQ_REL) == 0 ) {
+		recursive = __atomic_load_n(&node->recursive,__ATOMIC_RELAXED);
+		add_heavy(&heavy_recursive[thread_num],recursive,node->path);
+		parent = node->parent;
+		if ( parent != NULL ) {
+			__atomic_add_fetch(&parent->recursive,recursive,__ATOMIC_RELAXED);
+		} /* IF */
+		free(node);
+		node = parent;
+	} /* WHILE subtree is complete */
+
+	return;
+} /* end of finish_dir_node */
+
+/*********************************************************************
+*
+* Function  : subdir_path
+*
+* Purpose   : Build the path of a subdirectory.
+*
+* Inputs    : filepath - buffer of MAXPATHLEN bytes to receive the path
+*             dirname - path of the parent directory
+*             name - name of the subdirectory
+*             thread_num - number of the thread
+*
+* Output    : a warning if the path is too long
+*
+* Returns   : 0 on success , -1 if the path is too long
+*
+* Example   : if ( subdir_path(filepath,dirname,name,thread_num) == 0 ) ...
+*
+* Notes     : A truncated path could name an ancestor of the directory ,
+*             which would then be read again and again , so such a
+*             subdirectory is counted but not descended into.
+*
+*********************************************************************/
+
+int subdir_path(char *filepath, char *dirname, char *name, int thread_num)
+{
+	if ( snprintf(filepath,MAXPATHLEN,"%s/%s",dirname,name) >= MAXPATHLEN ) {
+		count_error(thread_num,ENAMETOOLONG);
+		fprintf(stderr,"Path too long , not descending into '%.60s...'\n",filepath);
+		return(-1);
+	} /* IF */
+
+	return(0);
+} /* end of subdir_path */
+
+/*********************************************************************
+*
+* Function  : skip_subdir
+*
+* Purpose   : Determine if a subdirectory is to be pruned.
+*
+* Inputs    : dir_fd - descriptor of the parent directory , or AT_FDCWD
+*             name - name of the subdirectory
+*             filepath - path of the subdirectory
+*             depth - depth of the subdirectory
+*             root - index of the root it is under
+*
+* Output    : (none)
+*
+* Returns   : 1 if it is not to be descended into , else 0
+*
+* Example   : if ( ! skip_subdir(dir_fd,entry->d_name,filepath,depth + 1,root) ) ...
+*
+* Notes     : Checked before the subdirectory is queued , so a pruned
+*             tree is never opened. The subdirectory itself is still
+*             counted. A -X pattern containing a '/' is matched against
+*             the path , otherwise against the name. Only -x needs the
+*             subdirectory to be stat'ed ; with -L that is the directory
+*             a link points to.
+*
+*********************************************************************/
+
+int skip_subdir(int dir_fd, char *name, char *filepath, int depth, int root)
+{
+	int		index;
+	struct stat	filestats;
+
+	if ( max_depth >= 0 && depth > max_depth ) {
+		return(1);
+	} /* IF */
+	for ( index = 0 ; index < num_skip_patterns ; ++index ) {
+		if ( strchr(skip_patterns[index],'/') != NULL ) {
+			if ( fnmatch(skip_patterns[index],filepath,FNM_PATHNAME) == 0 ) {
+				return(1);
+			} /* IF */
+		} /* IF */
+		else if ( fnmatch(skip_patterns[index],name,0) == 0 ) {
+			return(1);
+		} /* ELSE IF */
+	} /* FOR */
+	if ( opt_x ) {
+		if ( fstatat(dir_fd,(dir_fd == AT_FDCWD) ? filepath : name,&filestats,
+					opt_L ? 0 : AT_SYMLINK_NOFOLLOW) < 0 || filestats.st_dev != root_devs[root] ) {
+			return(1);
+		} /* IF */
+	} /* IF */
+
+	return(0);
+} /* end of skip_subdir */
+
+/*********************************************************************
+*
+* Function  : load_snapshot
+*
+* Purpose   : Load the snapshot of the previous run (-i).
+*
+* Inputs    : (none)
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : load_snapshot();
+*
+* Notes     : The file is mapped and its records are hashed by device
+*             and inode. A missing or invalid snapshot means that every
+*             directory is read.
+*
+*********************************************************************/
+
+void load_snapshot()
+{
+	int		fd;
+	struct stat	filestats;
+	SNAPHEADER	*header;
+	SNAPRECORD	*record;
+	char	*ptr , *end;
+	unsigned long	count , slot , mask;
+
+	fd = open(snapshot_path,O_RDONLY);
+	if ( fd < 0 ) {
+		return;
+	} /* IF */
+	if ( fstat(fd,&filestats) < 0 || filestats.st_size < sizeof(SNAPHEADER) ) {
+		close(fd);
+		return;
+	} /* IF */
+	snapshot_map = mmap(NULL,filestats.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if ( snapshot_map == MAP_FAILED ) {
+		snapshot_map = NULL;
+		return;
+	} /* IF */
+	snapshot_size = filestats.st_size;
+	header = (SNAPHEADER *)snapshot_map;
+	if ( memcmp(header->magic,SNAPSHOT_MAGIC,sizeof(header->magic)) != 0 ||
+				header->data_size != snapshot_size - sizeof(SNAPHEADER) ) {
+		fprintf(stderr,"Ignoring invalid snapshot file '%s'\n",snapshot_path);
+		munmap(snapshot_map,snapshot_size);
+		snapshot_map = NULL;
+		return;
+	} /* IF */
+
+	ptr = snapshot_map + sizeof(SNAPHEADER);
+	end = snapshot_map + snapshot_size;
+	for ( count = 0 ; ptr + sizeof(SNAPRECORD) <= end ; ++count ) {
+		record = (SNAPRECORD *)ptr;
+		if ( record->names_size < 0 || (record->names_size & 7) != 0 ||
+					record->names_size > end - ptr - sizeof(SNAPRECORD) ) {
+			break;
+		} /* IF damaged record */
+		ptr += sizeof(SNAPRECORD) + record->names_size;
+	} /* FOR */
+	for ( snapshot_index_size = 1024 ; snapshot_index_size < count * 2 ;
+				snapshot_index_size *= 2 ) {
+		;
+	} /* FOR */
+	snapshot_index = (SNAPRECORD **)calloc(snapshot_index_size,sizeof(SNAPRECORD *));
+	if ( snapshot_index == NULL ) {
+		quit(1,"calloc failed for snapshot index");
+	} /* IF */
+	mask = snapshot_index_size - 1;
+	for ( ptr = snapshot_map + sizeof(SNAPHEADER) ; ptr + sizeof(SNAPRECORD) <= end ;
+				ptr += sizeof(SNAPRECORD) + record->names_size ) {
+		record = (SNAPRECORD *)ptr;
+		if ( record->names_size < 0 || (record->names_size & 7) != 0 ||
+					record->names_size > end - ptr - sizeof(SNAPRECORD) ) {
+			break;
+		} /* IF damaged record */
+		slot = inode_hash(record->dev,record->ino) & mask;
+		while ( snapshot_index[slot] != NULL ) {
+			slot = (slot + 1) & mask;
+		} /* WHILE */
+		snapshot_index[slot] = record;
+	} /* FOR over records */
+
+	return;
+} /* end of load_snapshot */
+
+/*********************************************************************
+*
+* Function  : find_snapshot
+*
+* Purpose   : Find the previous record of an unchanged directory.
+*
+* Inputs    : dirstats - status of the directory
+*
+* Output    : (none)
+*
+* Returns   : pointer to record , NULL if the directory must be read
+*
+* Example   : record = find_snapshot(&dirstats);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+SNAPRECORD *find_snapshot(struct stat *dirstats)
+{
+	unsigned long	slot , mask;
+	SNAPRECORD	*record;
+
+	if ( snapshot_index == NULL ) {
+		return(NULL);
+	} /* IF */
+	mask = snapshot_index_size - 1;
+	slot = inode_hash(dirstats->st_dev,dirstats->st_ino) & mask;
+	for ( ; (record = snapshot_index[slot]) != NULL ; slot = (slot + 1) & mask ) {
+		if ( record->dev == dirstats->st_dev && record->ino == dirstats->st_ino ) {
+			if ( record->mtime_sec == dirstats->st_mtim.tv_sec &&
+						record->mtime_nsec == dirstats->st_mtim.tv_nsec ) {
+				return(record);
+			} /* IF */
+			break;
+		} /* IF */
+	} /* FOR */
+
+	return(NULL);
+} /* end of find_snapshot */
+
+/*********************************************************************
+*
+* Function  : append_snapshot
+*
+* Purpose   : Append a directory record to a thread's part of the new
+*             snapshot.
+*
+* Inputs    : thread_num - number of the thread
+*             record - the record
+*             names - subdirectory names (each NUL terminated)
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : append_snapshot(thread_num,&record,names);
+*
+* Notes     : record->names_size must already include the padding.
+*
+*********************************************************************/
+
+void append_snapshot(int thread_num, SNAPRECORD *record, char *names)
+{
+	SNAPBUF	*buffer;
+	size_t	needed;
+
+	buffer = &snap_buffers[thread_num];
+	needed = sizeof(SNAPRECORD) + record->names_size;
+	if ( buffer->used + needed > buffer->size ) {
+		while ( buffer->used + needed > buffer->size ) {
+			buffer->size = buffer->size ? buffer->size * 2 : INIT_SNAPBUF_SIZE;
+		} /* WHILE */
+		buffer->data = (char *)realloc(buffer->data,buffer->size);
+		if ( buffer->data == NULL ) {
+			quit(1,"realloc failed for snapshot buffer");
+		} /* IF */
+	} /* IF */
+	memcpy(buffer->data + buffer->used,record,sizeof(SNAPRECORD));
+	if ( record->names_size > 0 ) {
+		memcpy(buffer->data + buffer->used + sizeof(SNAPRECORD),names,
+				record->names_size);
+	} /* IF */
+	buffer->used += needed;
+
+	return;
+} /* end of append_snapshot */
+
+/*********************************************************************
+*
+* Function  : reuse_snapshot
+*
+* Purpose   : Count an unchanged directory from its previous record.
+*
+* Inputs    : record - the previous record
+*             dirname - directory name
+*             thread_num - number of the thread doing the counting
+*             root - index of the root it is under
+*             node - node of the directory for -D , else NULL
+*             depth - depth of the directory
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : reuse_snapshot(record,dirname,thread_num,root,node,depth);
+*
+* Notes     : The subdirectories are still queued , since a change
+*             inside a subdirectory does not alter the modification
+*             time of its parent.
+*
+*********************************************************************/
+
+void reuse_snapshot(SNAPRECORD *record, char *dirname, int thread_num, int root,
+				DIRNODE *node, int depth)
+{
+	int		index;
+	char	*name , filepath[MAXPATHLEN];
+	long	direct;
+
+	direct = 0;
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		class_list[index]->thread_counts[count_slot(root,thread_num)].num_entries +=
+					record->num_entries[index];
+		direct += record->num_entries[index];
+	} /* FOR */
+	name = (char *)(record + 1);
+	for ( index = 0 ; index < record->num_subdirs ; ++index ) {
+		if ( subdir_path(filepath,dirname,name,thread_num) == 0 &&
+					! skip_subdir(AT_FDCWD,name,filepath,depth + 1,root) ) {
+			queue_dir(thread_num,filepath,NULL,node,root,depth + 1);
+		} /* IF */
+		name += strlen(name) + 1;
+	} /* FOR */
+	append_snapshot(thread_num,record,(char *)(record + 1));
+	if ( node != NULL ) {
+		finish_dir_node(node,direct,thread_num);
+	} /* IF */
+
+	return;
+} /* end of reuse_snapshot */
+
+/*********************************************************************
+*
+* Function  : save_snapshot
+*
+* Purpose   : Write the new snapshot (-i).
+*
+* Inputs    : (none)
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : save_snapshot();
+*
+* Notes     : The file is written under a temporary name and renamed
+*             so that an interrupted run leaves the old snapshot intact.
+*
+*********************************************************************/
+
+void save_snapshot()
+{
+	char	temp_path[MAXPATHLEN];
+	int		fd , thread_num , ok;
+	SNAPHEADER	header;
+	FILE	*fp;
+
+	memset(&header,0,sizeof(header));
+	memcpy(header.magic,SNAPSHOT_MAGIC,sizeof(header.magic));
+	for ( thread_num = 0 ; thread_num < num_threads ; ++thread_num ) {
+		header.data_size += snap_buffers[thread_num].used;
+	} /* FOR */
+
+	snprintf(temp_path,sizeof(temp_path),"%s.XXXXXX",snapshot_path);
+	fd = mkstemp(temp_path);
+	if ( fd < 0 ) {
+		quit(1,"mkstemp failed for '%s'",temp_path);
+	} /* IF */
+	fp = fdopen(fd,"w");
+	if ( fp == NULL ) {
+		quit(1,"fdopen failed for '%s'",temp_path);
+	} /* IF */
+	fwrite(&header,sizeof(header),1,fp);
+	for ( thread_num = 0 ; thread_num < num_threads ; ++thread_num ) {
+		fwrite(snap_buffers[thread_num].data,1,snap_buffers[thread_num].used,fp);
+	} /* FOR */
+	ok = ! ferror(fp);
+	if ( fclose(fp) != 0 ) {
+		ok = 0;
+	} /* IF */
+	if ( ! ok || rename(temp_path,snapshot_path) < 0 ) {
+		unlink(temp_path);
+		quit(1,"Could not write snapshot file '%s'",snapshot_path);
+	} /* IF */
+
+	return;
+} /* end of save_snapshot */
+
+/*********************************************************************
+*
+* Function  : mode_to_class
+*
+* Purpose   : Get the class of a file type.
+*
+* Inputs    : filemode - S_IFMT file type bits
+*
+* Output    : (none)
+*
+* Returns   : index into class_list[]
+*
+* Example   : index = mode_to_class(filestats.st_mode & S_IFMT);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+int mode_to_class(mode_t filemode)
+{
+	switch ( filemode ) {
+	case S_IFREG:
+		return(0);
+	case S_IFDIR:
+		return(1);
+	case S_IFCHR:
+		return(2);
+	case S_IFBLK:
+		return(3);
+	case S_IFIFO:
+		return(4);
+	case S_IFLNK:
+		return(5);
+	case S_IFSOCK:
+		return(6);
+	} /* SWITCH */
+
+	return(7);
+} /* end of mode_to_class */
+
+/*********************************************************************
+*
+* Function  : new_watch_node
+*
+* Purpose   : Create the watch mode node of a directory.
+*
+* Inputs    : parent - node of the parent directory , NULL for the root
+*             name - name within the parent , or path of the root
+*
+* Output    : (none)
+*
+* Returns   : pointer to new node
+*
+* Example   : child = new_watch_node(watch,entry->d_name);
+*
+* Notes     : Only the thread scanning the parent adds its children ,
+*             so no lock is needed.
+*
+*********************************************************************/
+
+WATCHDIR *new_watch_node(WATCHDIR *parent, char *name)
+{
+	WATCHDIR	*node;
+
+	node = (WATCHDIR *)calloc(1,sizeof(WATCHDIR));
+	if ( node == NULL ) {
+		quit(1,"calloc failed for watch node");
+	} /* IF */
+	node->name = strdup(name);
+	if ( node->name == NULL ) {
+		quit(1,"strdup failed");
+	} /* IF */
+	node->wd = -1;
+	node->parent = parent;
+	if ( parent != NULL ) {
+		node->depth = parent->depth + 1;
+		node->next_sibling = parent->children;
+		parent->children = node;
+	} /* IF */
+
+	return(node);
+} /* end of new_watch_node */
+
+/*********************************************************************
+*
+* Function  : add_watch
+*
+* Purpose   : Place an inotify watch on a directory.
+*
+* Inputs    : node - node of the directory
+*             dirname - path of the directory
+*
+* Output    : a warning if the watch could not be added
+*
+* Returns   : (nothing)
+*
+* Example   : add_watch(watch,dirname);
+*
+* Notes     : A directory which can't be watched is still counted ,
+*             but later changes inside it are missed.
+*
+*********************************************************************/
+
+void add_watch(WATCHDIR *node, char *dirname)
+{
+	int		wd , new_size;
+	static	int	warned = 0;
+
+	wd = inotify_add_watch(inotify_fd,dirname,WATCH_EVENTS);
+	pthread_mutex_lock(&watch_lock);
+	if ( wd < 0 ) {
+		if ( ! warned ) {
+			system_error("inotify_add_watch failed for '%s' (further failures not shown)",
+						dirname);
+			warned = 1;
+		} /* IF */
+	} /* IF */
+	else {
+		if ( wd >= watch_table_size ) {
+			new_size = (wd + 1) * 2;
+			watch_table = (WATCHDIR **)realloc(watch_table,new_size * sizeof(WATCHDIR *));
+			if ( watch_table == NULL ) {
+				quit(1,"realloc failed for watch table");
+			} /* IF */
+			memset(&watch_table[watch_table_size],0,
+					(new_size - watch_table_size) * sizeof(WATCHDIR *));
+			watch_table_size = new_size;
+		} /* IF */
+		watch_table[wd] = node;
+		node->wd = wd;
+	} /* ELSE */
+	pthread_mutex_unlock(&watch_lock);
+
+	return;
+} /* end of add_watch */
+
+/*********************************************************************
+*
+* Function  : add_special
+*
+* Purpose   : Remember the class of a watched entry which is neither a
+*             regular file nor a directory.
+*
+* Inputs    : node - node of the directory holding the entry
+*             class_index - class of the entry
+*             name - name of the entry
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : add_special(watch,mode_to_class(filemode),entry->d_name);
+*
+* Notes     : A deleted entry can no longer be stat'ed. Directories are
+*             flagged by inotify and anything not remembered here is
+*             taken to be a regular file , so only these rarer entries
+*             need their names kept.
+*
+*********************************************************************/
+
+void add_special(WATCHDIR *node, int class_index, char *name)
+{
+	SPECIAL	*special;
+
+	special = (SPECIAL *)malloc(sizeof(SPECIAL) + strlen(name));
+	if ( special == NULL ) {
+		quit(1,"malloc failed for special entry");
+	} /* IF */
+	special->class_index = class_index;
+	strcpy(special->name,name);
+	special->next = node->specials;
+	node->specials = special;
+
+	return;
+} /* end of add_special */
+
+/*********************************************************************
+*
+* Function  : enter_subdir
+*
+* Purpose   : Arrange for a subdirectory to be read , unless it is
+*             pruned.
+*
+* Inputs    : scan - state of the directory being read
+*             name - name of the subdirectory , or of a link to it
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : enter_subdir(scan,name);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void enter_subdir(DIRSCAN *scan, char *name)
+{
+	char	filepath[MAXPATHLEN];
+	WATCHDIR	*child;
+
+	if ( subdir_path(filepath,scan->dirname,name,scan->thread_num) < 0 ||
+				skip_subdir(scan->dir_fd,name,filepath,scan->depth + 1,scan->root) ) {
+		return;
+	} /* IF too deep or pruned */
+	if ( collect_frontier && scan->depth + 1 >= approx_levels ) {
+		add_frontier(filepath);
+	} /* IF to be sampled later */
+	else {
+		child = (scan->watch == NULL) ? NULL : new_watch_node(scan->watch,name);
+		queue_dir(scan->thread_num,filepath,child,scan->node,scan->root,scan->depth + 1);
+	} /* ELSE */
+
+	return;
+} /* end of enter_subdir */
+
+/*********************************************************************
+*
+* Function  : count_entry
+*
+* Purpose   : Count one entry of the directory being read.
+*
+* Inputs    : scan - state of the directory being read
+*             name - name of the entry
+*             filemode - S_IFMT type bits of the entry , 0 if unknown
+*             filestats - status of the entry , NULL if not stat'ed
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : count_entry(&scan,entry->d_name,filemode,NULL);
+*
+* Notes     : Subdirectories are queued here , see process_dir(). With
+*             -L a symbolic link to a directory is still counted as a
+*             link , but the directory it points to is read as well.
+*
+*********************************************************************/
+
+void count_entry(DIRSCAN *scan, char *name, mode_t filemode, struct stat *filestats)
+{
+	struct stat	*statptr , target;
+	size_t	length;
+	int		thread_num , slot;
+
+	if ( filemode == 0 ) {
+		return;
+	} /* IF type is not known */
+	thread_num = scan->thread_num;
+	slot = scan->slot;
+	statptr = opt_s ? filestats : NULL;
+	switch ( filemode ) {
+	case S_IFDIR:
+		add_to_class(&dir_class,slot,statptr);
+		enter_subdir(scan,name);
+		if ( opt_i ) {
+			length = strlen(name) + 1;
+			if ( scan->names_used + length + 8 > scan->names_size ) {
+				scan->names_size = (scan->names_size + length) * 2 + 256;
+				scan->names = (char *)realloc(scan->names,scan->names_size);
+				if ( scan->names == NULL ) {
+					quit(1,"realloc failed for subdirectory names");
+				} /* IF */
+			} /* IF */
+			memcpy(scan->names + scan->names_used,name,length);
+			scan->names_used += length;
+			scan->record.num_subdirs += 1;
+		} /* IF */
+		break;
+	case S_IFREG:
+		add_to_class(&regular_class,slot,statptr);
+		if ( opt_e ) {
+			add_extension(thread_num,name,(filestats == NULL) ? 0 : filestats->st_size);
+		} /* IF */
+		break;
+	case S_IFBLK:
+		add_to_class(&block_class,slot,statptr);
+		break;
+	case S_IFCHR:
+		add_to_class(&char_class,slot,statptr);
+		break;
+	case S_IFIFO:
+		add_to_class(&pipe_class,slot,statptr);
+		break;
+	case S_IFLNK:
+		add_to_class(&symlink_class,slot,statptr);
+		if ( opt_L && fstatat(scan->dir_fd,name,&target,0) == 0 && S_ISDIR(target.st_mode) ) {
+			enter_subdir(scan,name);
+		} /* IF link to a directory is to be followed */
+		break;
+	case S_IFSOCK:
+		add_to_class(&socket_class,slot,statptr);
+		break;
+	default:
+		fprintf(stderr,"Unexpected mode %o for %s\n", filemode,name);
+		add_to_class(&misc_class,slot,statptr);
+	} /* end of SWITCH */
+	if ( scan->watch != NULL && filemode != S_IFREG && filemode != S_IFDIR ) {
+		add_special(scan->watch,mode_to_class(filemode),name);
+	} /* IF */
+
+	return;
+} /* end of count_entry */
+
+/*********************************************************************
+*
+* Function  : setup_ring
+*
+* Purpose   : Create the io_uring of a thread for batched statx
+*             requests (-U).
+*
+* Inputs    : ring - ring to be set up
+*
+* Output    : (none)
+*
+* Returns   : 0 on success , else the errno value
+*
+* Example   : errcode = setup_ring(&stat_rings[thread_num]);
+*
+* Notes     : The raw system calls are used , so liburing is not
+*             needed. The ring is only used if the kernel supports
+*             IORING_OP_STATX.
+*
+*********************************************************************/
+
+int setup_ring(STATRING *ring)
+{
+	struct io_uring_params	params;
+	struct io_uring_probe	*probe;
+	size_t	sq_size , cq_size , probe_size;
+	char	*sq_map , *cq_map;
+	int		index , supported;
+
+	memset(&params,0,sizeof(params));
+	ring->fd = syscall(__NR_io_uring_setup,RING_ENTRIES,&params);
+	if ( ring->fd < 0 ) {
+		return(errno);
+	} /* IF */
+
+	probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+	probe = (struct io_uring_probe *)calloc(1,probe_size);
+	if ( probe == NULL ) {
+		quit(1,"calloc failed for io_uring probe");
+	} /* IF */
+	supported = syscall(__NR_io_uring_register,ring->fd,IORING_REGISTER_PROBE,probe,256) == 0 &&
+			probe->last_op >= IORING_OP_STATX &&
+			(probe->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED);
+	free(probe);
+	if ( ! supported ) {
+		close(ring->fd);
+		return(EOPNOTSUPP);
+	} /* IF */
+
+	sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if ( params.features & IORING_FEAT_SINGLE_MMAP ) {
+		sq_size = cq_size = (sq_size > cq_size) ? sq_size : cq_size;
+	} /* IF */
+	sq_map = mmap(NULL,sq_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,
+				ring->fd,IORING_OFF_SQ_RING);
+	if ( sq_map == MAP_FAILED ) {
+		quit(1,"mmap failed for io_uring submission queue");
+	} /* IF */
+	if ( params.features & IORING_FEAT_SINGLE_MMAP ) {
+		cq_map = sq_map;
+	} /* IF */
+	else {
+		cq_map = mmap(NULL,cq_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,
+					ring->fd,IORING_OFF_CQ_RING);
+		if ( cq_map == MAP_FAILED ) {
+			quit(1,"mmap failed for io_uring completion queue");
+		} /* IF */
+	} /* ELSE */
+	ring->sqes = mmap(NULL,params.sq_entries * sizeof(struct io_uring_sqe),
+				PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,ring->fd,IORING_OFF_SQES);
+	if ( ring->sqes == MAP_FAILED ) {
+		quit(1,"mmap failed for io_uring submission entries");
+	} /* IF */
+
+	ring->sq_head = (unsigned *)(sq_map + params.sq_off.head);
+	ring->sq_tail = (unsigned *)(sq_map + params.sq_off.tail);
+	ring->sq_mask = *(unsigned *)(sq_map + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)(sq_map + params.sq_off.array);
+	ring->cq_head = (unsigned *)(cq_map + params.cq_off.head);
+	ring->cq_tail = (unsigned *)(cq_map + params.cq_off.tail);
+	ring->cq_mask = *(unsigned *)(cq_map + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq_map + params.cq_off.cqes);
+	ring->to_submit = 0;
+	ring->num_free = RING_ENTRIES;
+	for ( index = 0 ; index < RING_ENTRIES ; ++index ) {
+		ring->free_slots[index] = index;
+	} /* FOR */
+
+	return(0);
+} /* end of setup_ring */
+
+/*********************************************************************
+*
+* Function  : reap_stats
+*
+* Purpose   : Submit the queued statx requests of a thread and count
+*             the entries whose requests have completed (-U).
+*
+* Inputs    : ring - ring of the thread
+*             scan - state of the directory being read
+*             min_complete - number of completions to wait for
+*
+* Output    : a warning for each failed request
+*
+* Returns   : (nothing)
+*
+* Example   : reap_stats(ring,&scan,1);
+*
+* Notes     : The time spent waiting is counted as stat time for -S.
+*
+*********************************************************************/
+
+void reap_stats(STATRING *ring, DIRSCAN *scan, int min_complete)
+{
+	struct io_uring_cqe	*cqe;
+	struct stat	filestats;
+	struct statx	*stx;
+	STATSLOT	*slot;
+	unsigned	head , tail;
+	int		status , thread_num;
+	double	start;
+
+	thread_num = scan->thread_num;
+	start = opt_S ? now_secs() : 0;
+	do {
+		status = syscall(__NR_io_uring_enter,ring->fd,ring->to_submit,min_complete,
+					(min_complete > 0) ? IORING_ENTER_GETEVENTS : 0,NULL,0);
+	} while ( status < 0 && errno == EINTR );
+	if ( status < 0 ) {
+		quit(1,"io_uring_enter failed");
+	} /* IF */
+	ring->to_submit -= status;
+	if ( opt_S ) {
+		thread_stats[thread_num].stat_secs += now_secs() - start;
+	} /* IF */
+
+	head = *ring->cq_head;
+	tail = __atomic_load_n(ring->cq_tail,__ATOMIC_ACQUIRE);
+	for ( ; head != tail ; ++head ) {
+		cqe = &ring->cqes[head & ring->cq_mask];
+		slot = &ring->slots[cqe->user_data];
+		thread_stats[thread_num].num_stats += 1;
+		if ( cqe->res < 0 ) {
+			count_error(thread_num,-cqe->res);
+			errno = -cqe->res;
+			system_error("statx failed for '%s/%s'",scan->dirname,slot->name);
+			count_entry(scan,slot->name,slot->filemode,NULL);
+		} /* IF */
+		else {
+			stx = &slot->stx;
+			memset(&filestats,0,sizeof(filestats));
+			filestats.st_mode = stx->stx_mode;
+			filestats.st_nlink = stx->stx_nlink;
+			filestats.st_dev = makedev(stx->stx_dev_major,stx->stx_dev_minor);
+			filestats.st_ino = stx->stx_ino;
+			filestats.st_size = stx->stx_size;
+			filestats.st_blocks = stx->stx_blocks;
+			count_entry(scan,slot->name,stx->stx_mode & S_IFMT,&filestats);
+		} /* ELSE */
+		ring->free_slots[ring->num_free++] = slot - ring->slots;
+	} /* FOR over completions */
+	__atomic_store_n(ring->cq_head,head,__ATOMIC_RELEASE);
+
+	return;
+} /* end of reap_stats */
+
+/*********************************************************************
+*
+* Function  : queue_stat
+*
+* Purpose   : Queue a statx request for a directory entry (-U).
+*
+* Inputs    : ring - ring of the thread
+*             scan - state of the directory being read
+*             name - name of the entry
+*             filemode - type from readdir() , 0 if unknown
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : queue_stat(ring,&scan,entry->d_name,filemode);
+*
+* Notes     : Requests are submitted in batches while the directory is
+*             still being read , and the entry is counted when its
+*             request completes. Completions are only waited for when
+*             every slot is in use.
+*
+*********************************************************************/
+
+void queue_stat(STATRING *ring, DIRSCAN *scan, char *name, mode_t filemode)
+{
+	struct io_uring_sqe	*sqe;
+	STATSLOT	*slot;
+	unsigned	tail;
+	int		slot_num;
+
+	if ( ring->num_free == 0 ) {
+		reap_stats(ring,scan,1);
+	} /* IF */
+	slot_num = ring->free_slots[--ring->num_free];
+	slot = &ring->slots[slot_num];
+	snprintf(slot->name,sizeof(slot->name),"%s",name);
+	slot->filemode = filemode;
+
+	tail = *ring->sq_tail;
+	sqe = &ring->sqes[tail & ring->sq_mask];
+	memset(sqe,0,sizeof(*sqe));
+	sqe->opcode = IORING_OP_STATX;
+	sqe->fd = scan->dir_fd;
+	sqe->addr = (unsigned long)slot->name;
+	sqe->len = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_INO | STATX_SIZE | STATX_BLOCKS;
+	sqe->off = (unsigned long)&slot->stx;
+	sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+	sqe->user_data = slot_num;
+	ring->sq_array[tail & ring->sq_mask] = tail & ring->sq_mask;
+	__atomic_store_n(ring->sq_tail,tail + 1,__ATOMIC_RELEASE);
+	ring->to_submit += 1;
+	if ( ring->to_submit >= RING_SUBMIT_BATCH ) {
+		reap_stats(ring,scan,0);
+	} /* IF */
+
+	return;
+} /* end of queue_stat */
+
+/*********************************************************************
+*
+* Function  : process_dir
+*
+* Purpose   : Process a directory
+*
+* Inputs    : char *dirname - directory name
+*             int thread_num - number of the thread doing the scan
+*             int root - index of the root it is under
+*             WATCHDIR *watch - node of the directory in watch mode ,
+*                               else NULL
+*             DIRNODE *node - node of the directory for -D , else NULL
+*             int depth - depth of the directory , 0 for the top
+*
+* Output    : appropriate messages
+*
+* Returns   : (nothing)
+*
+* Example   : process_dir(".",0,0,NULL,NULL,0)
+*
+* Notes     : Subdirectories are queued on the deque of the calling
+*             thread , see traverse_tree(). Entries are classified by
+*             the d_type from readdir() ; only when that is DT_UNKNOWN
+*             or disk usage is wanted (-s) is the entry stat'ed ,
+*             relative to the open directory. With -U those statx calls
+*             go through the thread's io_uring while the directory is
+*             still being read. With -e regular files
+*             are stat'ed for their size. With -i a directory whose
+*             modification time matches the previous snapshot is not
+*             read at all. In watch mode the directory is watched before
+*             it is read and its counts are kept in its node. With -L a
+*             directory which has already been read , through a link or
+*             a cycle , is skipped.
+*
+*********************************************************************/
+
+void process_dir(char *dirname, int thread_num, int root, WATCHDIR *watch, DIRNODE *node,
+				int depth)
+{
+	DIR	*dirptr;
+	struct dirent	*entry;
+	struct stat	filestats;
+	mode_t	filemode;
+	int		index , before[NUM_CLASSES] , have_stats;
+	struct stat	dirstats , newstats;
+	SNAPRECORD	*previous;
+	size_t	length;
+	THREADSTATS	*stats;
+	STATRING	*ring;
+	DIRSCAN	scan;
+	double	start;
+
+	stats = &thread_stats[thread_num];
+	start = opt_S ? now_secs() : 0;
+	if ( opt_p && pthread_mutex_trylock(&progress_lock) == 0 ) {
+		snprintf(current_path,sizeof(current_path),"%s",dirname);
+		pthread_mutex_unlock(&progress_lock);
+	} /* IF progress line is not being shown right now */
+	if ( watch != NULL ) {
+		add_watch(watch,dirname);
+	} /* IF */
+	dirptr = open_dir(dirname,thread_num);
+	if ( dirptr == NULL ) {
+		if ( node != NULL ) {
+			finish_dir_node(node,0,thread_num);
+		} /* IF */
+		return;
+	} /* IF */
+	memset(&scan,0,sizeof(scan));
+	scan.dirname = dirname;
+	scan.dir_fd = dirfd(dirptr);
+	scan.thread_num = thread_num;
+	scan.root = root;
+	scan.slot = count_slot(root,thread_num);
+	scan.watch = watch;
+	scan.node = node;
+	scan.depth = depth;
+	if ( opt_L ) {
+		if ( fstat(scan.dir_fd,&dirstats) < 0 ) {
+			quit(1,"fstat failed for '%s'",dirname);
+		} /* IF */
+		if ( ! add_inode(&visited_set,dirstats.st_dev,dirstats.st_ino) ) {
+			closedir(dirptr);
+			if ( node != NULL ) {
+				finish_dir_node(node,0,thread_num);
+			} /* IF */
+			return;
+		} /* IF already read through another path */
+	} /* IF */
+	if ( opt_i ) {
+		if ( fstat(scan.dir_fd,&dirstats) < 0 ) {
+			quit(1,"fstat failed for '%s'",dirname);
+		} /* IF */
+		previous = find_snapshot(&dirstats);
+		if ( previous != NULL ) {
+			closedir(dirptr);
+			reuse_snapshot(previous,dirname,thread_num,root,node,depth);
+			return;
+		} /* IF directory is unchanged */
+	} /* IF incremental */
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		before[index] = class_list[index]->thread_counts[scan.slot].num_entries;
+	} /* FOR */
+	ring = (stat_rings == NULL) ? NULL : &stat_rings[thread_num];
+
+	while ( (entry = read_dir(dirptr,dirname,thread_num)) != NULL ) {
+		if ( EQ(entry->d_name,".") || EQ(entry->d_name,"..") ) {
+			continue;
+		} /* skip over '.' and '..' */
+		filemode = dtype_to_mode(entry->d_type);
+		have_stats = 0;
+		if ( filemode == 0 || opt_s || (opt_e && filemode == S_IFREG) ) {
+			if ( ring != NULL ) {
+				queue_stat(ring,&scan,entry->d_name,filemode);
+				continue;
+			} /* IF the status will arrive later */
+			if ( stat_entry(scan.dir_fd,dirname,entry->d_name,&filestats,thread_num) == 0 ) {
+				filemode = filestats.st_mode & S_IFMT;
+				have_stats = 1;
+			} /* IF */
+		} /* IF type not reported by readdir() or sizes are wanted */
+		count_entry(&scan,entry->d_name,filemode,have_stats ? &filestats : NULL);
+	} /* FOR loop over directory entries */
+	if ( ring != NULL ) {
+		while ( ring->num_free < RING_ENTRIES ) {
+			reap_stats(ring,&scan,1);
+		} /* WHILE */
+	} /* IF */
+
+	if ( opt_i ) {
+		scan.record.dev = dirstats.st_dev;
+		scan.record.ino = dirstats.st_ino;
+		scan.record.mtime_sec = dirstats.st_mtim.tv_sec;
+		scan.record.mtime_nsec = dirstats.st_mtim.tv_nsec;
+		if ( time(NULL) - dirstats.st_mtim.tv_sec < SNAPSHOT_RACY_SECS ||
+				fstat(scan.dir_fd,&newstats) < 0 ||
+				newstats.st_mtim.tv_sec != dirstats.st_mtim.tv_sec ||
+				newstats.st_mtim.tv_nsec != dirstats.st_mtim.tv_nsec ) {
+			scan.record.mtime_nsec = -1;
+		} /* IF changed recently or while being read */
+		for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+			scan.record.num_entries[index] = class_list[index]->thread_counts[scan.slot].num_entries -
+								before[index];
+		} /* FOR */
+		scan.record.names_size = (scan.names_used + 7) & ~7;
+		if ( scan.names != NULL ) {
+			memset(scan.names + scan.names_used,0,scan.record.names_size - scan.names_used);
+		} /* IF */
+		append_snapshot(thread_num,&scan.record,scan.names);
+		free(scan.names);
+	} /* IF incremental */
+	if ( watch != NULL ) {
+		for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+			watch->num_entries[index] += class_list[index]->thread_counts[scan.slot].num_entries -
+								before[index];
+		} /* FOR */
+	} /* IF */
+	closedir(dirptr);
+	length = 0;
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		length += class_list[index]->thread_counts[scan.slot].num_entries - before[index];
+	} /* FOR */
+	__atomic_store_n(&stats->num_entries,stats->num_entries + length,__ATOMIC_RELAXED);
+	__atomic_store_n(&stats->num_dirs,stats->num_dirs + 1,__ATOMIC_RELAXED);
+	if ( node != NULL ) {
+		finish_dir_node(node,length,thread_num);
+	} /* IF */
+	if ( opt_S ) {
+		note_dir_time(thread_num,dirname,now_secs() - start);
+	} /* IF */
+
+	return;
+} /* end of process_dir */
+
+/*********************************************************************
+*
+* Function  : push_dir
+*
+* Purpose   : Push a directory onto the bottom of a work deque.
+*
+* Inputs    : deque - pointer to work deque
+*             item - queued directory , owned by the deque afterwards
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : push_dir(&worker->deque,item);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void push_dir(WORKDEQUE *deque, WORKITEM *item)
+{
+	pthread_mutex_lock(&deque->lock);
+	if ( deque->bottom >= deque->capacity ) {
+		if ( deque->top > 0 ) {
+			memmove(deque->items,&deque->items[deque->top],
+					(deque->bottom - deque->top) * sizeof(WORKITEM *));
+			deque->bottom -= deque->top;
+			deque->top = 0;
+		} /* IF stolen slots can be reclaimed */
+		if ( deque->bottom >= deque->capacity ) {
+			deque->capacity = deque->capacity ? deque->capacity * 2 : INIT_DEQUE_SIZE;
+			deque->items = (WORKITEM **)realloc(deque->items,
+							deque->capacity * sizeof(WORKITEM *));
+			if ( deque->items == NULL ) {
+				quit(1,"realloc failed for work deque");
+			} /* IF */
+		} /* IF */
+	} /* IF deque is full */
+	deque->items[deque->bottom++] = item;
+	pthread_mutex_unlock(&deque->lock);
+
+	return;
+} /* end of push_dir */
+
+/*********************************************************************
+*
+* Function  : pop_dir
+*
+* Purpose   : Take a directory from a work deque.
+*
+* Inputs    : deque - pointer to work deque
+*             steal - non-zero to take from the top instead of the bottom
+*
+* Output    : (none)
+*
+* Returns   : queued directory , NULL if the deque is empty
+*
+* Example   : item = pop_dir(&worker->deque,0);
+*
+* Notes     : The owner takes its newest directory (depth first , the
+*             parent was just read) while thieves take the oldest one ,
+*             which is usually nearest the root and has the most work
+*             under it.
+*
+*********************************************************************/
+
+WORKITEM *pop_dir(WORKDEQUE *deque, int steal)
+{
+	WORKITEM	*item;
+
+	item = NULL;
+	pthread_mutex_lock(&deque->lock);
+	if ( deque->bottom > deque->top ) {
+		if ( steal ) {
+			item = deque->items[deque->top++];
+		} /* IF */
+		else {
+			item = deque->items[--deque->bottom];
+		} /* ELSE */
+		if ( deque->bottom == deque->top ) {
+			deque->top = 0;
+			deque->bottom = 0;
+		} /* IF deque is now empty */
+	} /* IF */
+	pthread_mutex_unlock(&deque->lock);
+
+	return(item);
+} /* end of pop_dir */
+
+/*********************************************************************
+*
+* Function  : queue_dir
+*
+* Purpose   : Queue a subdirectory for scanning.
+*
+* Inputs    : thread_num - number of the thread which found it
+*             dirname - directory name
+*             watch - node of the directory in watch mode , else NULL
+*             parent - -D node of the directory which contains it ,
+*                      NULL for the top directory
+*             root - index of the root it is under
+*             depth - depth of the directory
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : queue_dir(thread_num,filepath,NULL,scan->node,scan->root,depth + 1);
+*
+* Notes     : The directory is counted as pending before it becomes
+*             visible to thieves so that the count can't reach zero
+*             while work remains. The same holds for its -D node and
+*             the node of its parent.
+*
+*********************************************************************/
+
+void queue_dir(int thread_num, char *dirname, WATCHDIR *watch, DIRNODE *parent, int root,
+				int depth)
+{
+	WORKITEM	*item;
+
+	item = (WORKITEM *)malloc(sizeof(WORKITEM) + strlen(dirname));
+	if ( item == NULL ) {
+		quit(1,"malloc failed for queued directory");
+	} /* IF */
+	item->watch = watch;
+	item->node = (heavy_n > 0) ? new_dir_node(parent,dirname) : NULL;
+	item->root = root;
+	item->depth = depth;
+	strcpy(item->path,dirname);
+	pthread_mutex_lock(&work_lock);
+	pending_dirs += 1;
+	work_generation += 1;
+	if ( idle_workers > 0 ) {
+		pthread_cond_signal(&work_cond);
+	} /* IF */
+	pthread_mutex_unlock(&work_lock);
+	push_dir(&workers[thread_num].deque,item);
+
+	return;
+} /* end of queue_dir */
+
+/*********************************************************************
+*
+* Function  : next_dir
+*
+* Purpose   : Get the next directory for a worker thread to scan.
+*
+* Inputs    : worker - pointer to worker structure
+*
+* Output    : (none)
+*
+* Returns   : queued directory , NULL when the whole tree has been scanned
+*
+* Example   : item = next_dir(worker);
+*
+* Notes     : The worker's own deque is tried first , then the deques
+*             of the other workers. If nothing can be found the worker
+*             sleeps until another directory is queued.
+*
+*********************************************************************/
+
+WORKITEM *next_dir(WORKER *worker)
+{
+	WORKITEM	*item;
+	int		index , victim;
+	unsigned long	generation;
+
+	for ( ; ; ) {
+		pthread_mutex_lock(&work_lock);
+		generation = work_generation;
+		pthread_mutex_unlock(&work_lock);
+
+		item = pop_dir(&worker->deque,0);
+		for ( index = 1 ; item == NULL && index < num_threads ; ++index ) {
+			victim = (worker->thread_num + index) % num_threads;
+			item = pop_dir(&workers[victim].deque,1);
+		} /* FOR over other workers */
+		if ( item != NULL ) {
+			return(item);
+		} /* IF */
+
+		pthread_mutex_lock(&work_lock);
+		idle_workers += 1;
+		while ( pending_dirs > 0 && work_generation == generation ) {
+			pthread_cond_wait(&work_cond,&work_lock);
+		} /* WHILE */
+		idle_workers -= 1;
+		if ( pending_dirs == 0 ) {
+			pthread_mutex_unlock(&work_lock);
+			return(NULL);
+		} /* IF traversal is complete */
+		pthread_mutex_unlock(&work_lock);
+	} /* FOR */
+} /* end of next_dir */
+
+/*********************************************************************
+*
+* Function  : worker_main
+*
+* Purpose   : Main routine of a traversal worker thread.
+*
+* Inputs    : arg - pointer to worker structure
+*
+* Output    : appropriate messages
+*
+* Returns   : NULL
+*
+* Example   : pthread_create(&worker->thread,NULL,worker_main,worker);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void *worker_main(void *arg)
+{
+	WORKER	*worker;
+	WORKITEM	*item;
+
+	worker = (WORKER *)arg;
+	while ( (item = next_dir(worker)) != NULL ) {
+		process_dir(item->path,worker->thread_num,item->root,item->watch,item->node,
+				item->depth);
+		free(item);
+
+		pthread_mutex_lock(&work_lock);
+		pending_dirs -= 1;
+		if ( pending_dirs == 0 ) {
+			pthread_cond_broadcast(&work_cond);
+		} /* IF traversal is complete */
+		pthread_mutex_unlock(&work_lock);
+	} /* WHILE */
+
+	return(NULL);
+} /* end of worker_main */
+
+/*********************************************************************
+*
+* Function  : traverse_tree
+*
+* Purpose   : Count the files under one or more directories with a
+*             pool of work-stealing threads.
+*
+* Inputs    : dirnames - names of the top level directories , the
+*                        index of each is its root index
+*             num_dirs - number of directories
+*             watch - node of the directory in watch mode , else NULL
+*             depth - depth of the directories
+*
+* Output    : appropriate messages
+*
+* Returns   : (nothing)
+*
+* Example   : traverse_tree(root_paths,num_roots,NULL,0);
+*
+* Notes     : All the directories are queued before the workers start ,
+*             so that trees on different devices are read at the same
+*             time. With a single thread the worker runs on the main thread.
+*             Its deque is then a stack of the directories still to be
+*             scanned , so memory is proportional to the frontier of the
+*             traversal rather than to the whole tree , and each path is
+*             freed as soon as its directory has been read.
+*
+*********************************************************************/
+
+void traverse_tree(char **dirnames, int num_dirs, WATCHDIR *watch, int depth)
+{
+	int		thread_num , errcode , index;
+
+	workers = (WORKER *)calloc(num_threads,sizeof(WORKER));
+	if ( workers == NULL ) {
+		quit(1,"calloc failed for %d workers",num_threads);
+	} /* IF */
+	for ( thread_num = 0 ; thread_num < num_threads ; ++thread_num ) {
+		workers[thread_num].thread_num = thread_num;
+		pthread_mutex_init(&workers[thread_num].deque.lock,NULL);
+	} /* FOR */
+	for ( index = num_dirs - 1 ; index >= 0 ; --index ) {
+		queue_dir(0,dirnames[index],watch,NULL,index,depth);
+	} /* FOR roots in reverse , so that a single thread takes them in order */
+
+	if ( num_threads == 1 ) {
+		worker_main(&workers[0]);
+	} /* IF */
+	else {
+		for ( thread_num = 0 ; thread_num < num_threads ; ++thread_num ) {
+			errcode = pthread_create(&workers[thread_num].thread,NULL,worker_main,
+								&workers[thread_num]);
+			if ( errcode != 0 ) {
+				die(1,"pthread_create failed : %s\n",strerror(errcode));
+			} /* IF */
+		} /* FOR */
+		for ( thread_num = 0 ; thread_num < num_threads ; ++thread_num ) {
+			pthread_join(workers[thread_num].thread,NULL);
+		} /* FOR */
+	} /* ELSE */
+	for ( thread_num = 0 ; thread_num < num_threads ; ++thread_num ) {
+		free(workers[thread_num].deque.items);
+		pthread_mutex_destroy(&workers[thread_num].deque.lock);
+	} /* FOR */
+	free(workers);
+	workers = NULL;
+
+	return;
+} /* end of traverse_tree */
+
+/*********************************************************************
+*
+* Function  : progress_main
+*
+* Purpose   : Main routine of the thread which shows the progress line
+*             on stderr (-p).
+*
+* Inputs    : arg - (not used)
+*
+* Output    : progress line , rewritten every second
+*
+* Returns   : NULL
+*
+* Example   : pthread_create(&thread,NULL,progress_main,NULL);
+*
+* Notes     : The rates are for the last interval. The counters of the
+*             workers are read without locks , so they may lag a little.
+*
+*********************************************************************/
+
+void *progress_main(void *arg)
+{
+	struct timespec	wakeup;
+	unsigned long	dirs , entries , last_dirs , last_entries;
+	double	now , last_time;
+	int		thread_num , queued;
+
+	last_dirs = 0;
+	last_entries = 0;
+	last_time = now_secs();
+	pthread_mutex_lock(&progress_lock);
+	while ( ! progress_done ) {
+		clock_gettime(CLOCK_REALTIME,&wakeup);
+		wakeup.tv_sec += 1;
+		pthread_cond_timedwait(&progress_cond,&progress_lock,&wakeup);
+		if ( progress_done ) {
+			break;
+		} /* IF */
+		dirs = 0;
+		entries = 0;
+		for ( thread_num = 0 ; thread_num < num_threads ; ++thread_num ) {
+			dirs += __atomic_load_n(&thread_stats[thread_num].num_dirs,__ATOMIC_RELAXED);
+			entries += __atomic_load_n(&thread_stats[thread_num].num_entries,__ATOMIC_RELAXED);
+		} /* FOR */
+		pthread_mutex_lock(&work_lock);
+		queued = pending_dirs;
+		pthread_mutex_unlock(&work_lock);
+		now = now_secs();
+		fprintf(stderr,"\r%lu dirs (%.0f/s) , %lu entries (%.0f/s) , queue %d : %-50.50s",
+				dirs,(dirs - last_dirs) / (now - last_time),
+				entries,(entries - last_entries) / (now - last_time),queued,current_path);
+		last_dirs = dirs;
+		last_entries = entries;
+		last_time = now;
+	} /* WHILE */
+	pthread_mutex_unlock(&progress_lock);
+	fprintf(stderr,"\n");
+
+	return(NULL);
+} /* end of progress_main */
+
+/*********************************************************************
+*
+* Function  : compare_slowest
+*
+* Purpose   : Compare two slow directories for qsort() , slowest first.
+*
+* Inputs    : ptr1 - pointer to first directory
+*             ptr2 - pointer to second directory
+*
+* Output    : (none)
+*
+* Returns   : <0 , 0 , >0
+*
+* Example   : qsort(slowest,count,sizeof(SLOWDIR),compare_slowest);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+int compare_slowest(const void *ptr1, const void *ptr2)
+{
+	double	secs1 , secs2;
+
+	secs1 = ((SLOWDIR *)ptr1)->secs;
+	secs2 = ((SLOWDIR *)ptr2)->secs;
+
+	return( (secs1 < secs2) - (secs1 > secs2) );
+} /* end of compare_slowest */
+
+/*********************************************************************
+*
+* Function  : dump_stats
+*
+* Purpose   : Display where the traversal time went (-S).
+*
+* Inputs    : elapsed - elapsed time of the traversal
+*
+* Output    : timing breakdown , error counts and slowest directories
+*             on stderr
+*
+* Returns   : (nothing)
+*
+* Example   : dump_stats(now_secs() - start);
+*
+* Notes     : The system call times are summed over all the threads ,
+*             so with -T they can exceed the elapsed time.
+*
+*********************************************************************/
+
+void dump_stats(double elapsed)
+{
+	THREADSTATS	totals;
+	SLOWDIR	slowest[MAX_SLOWEST * MAX_THREADS];
+	int		thread_num , index , count , any_errors;
+
+	memset(&totals,0,sizeof(totals));
+	count = 0;
+	for ( thread_num = 0 ; thread_num < num_threads ; ++thread_num ) {
+		totals.num_dirs += thread_stats[thread_num].num_dirs;
+		totals.num_entries += thread_stats[thread_num].num_entries;
+		totals.num_stats += thread_stats[thread_num].num_stats;
+		totals.opendir_secs += thread_stats[thread_num].opendir_secs;
+		totals.readdir_secs += thread_stats[thread_num].readdir_secs;
+		totals.stat_secs += thread_stats[thread_num].stat_secs;
+		for ( index = 0 ; index < MAX_ERRNO ; ++index ) {
+			totals.errors[index] += thread_stats[thread_num].errors[index];
+		} /* FOR */
+		for ( index = 0 ; index < thread_stats[thread_num].num_slowest ; ++index ) {
+			slowest[count++] = thread_stats[thread_num].slowest[index];
+		} /* FOR */
+	} /* FOR over threads */
+
+	fprintf(stderr,"\nElapsed time             %.3f secs\n",elapsed);
+	fprintf(stderr,"Directories read         %lu\n",totals.num_dirs);
+	fprintf(stderr,"Entries                  %lu\n",totals.num_entries);
+	fprintf(stderr,"opendir() time           %.3f secs\n",totals.opendir_secs);
+	fprintf(stderr,"readdir() time           %.3f secs\n",totals.readdir_secs);
+	fprintf(stderr,"fstatat() time           %.3f secs for %lu calls\n",totals.stat_secs,
+				totals.num_stats);
+	any_errors = 0;
+	for ( index = 0 ; index < MAX_ERRNO ; ++index ) {
+		if ( totals.errors[index] > 0 ) {
+			if ( ! any_errors ) {
+				fprintf(stderr,"Errors\n");
+				any_errors = 1;
+			} /* IF */
+			fprintf(stderr,"  %6d  errno %d (%s)\n",totals.errors[index],index,
+						index ? strerror(index) : "other");
+		} /* IF */
+	} /* FOR */
+	if ( ! any_errors ) {
+		fprintf(stderr,"Errors                   0\n");
+	} /* IF */
+
+	qsort(slowest,count,sizeof(SLOWDIR),compare_slowest);
+	fprintf(stderr,"Slowest directories\n");
+	for ( index = 0 ; index < count && index < MAX_SLOWEST ; ++index ) {
+		fprintf(stderr,"  %8.4f secs  %s\n",slowest[index].secs,slowest[index].path);
+	} /* FOR */
+
+	return;
+} /* end of dump_stats */
+
+/*********************************************************************
+*
+* Function  : merge_counts
+*
+* Purpose   : Merge the per-thread counters of every class.
+*
+* Inputs    : root - index of the root to be merged , -1 for all
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : merge_counts(-1);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void merge_counts(int root)
+{
+	int		index , slot , first_slot , last_slot;
+	FILECLASS	*class_ptr;
+
+	first_slot = (root < 0) ? 0 : count_slot(root,0);
+	last_slot = (root < 0) ? count_slot(num_roots,0) : count_slot(root + 1,0);
+	for ( index = 0 ; index < num_classes ; ++index ) {
+		class_ptr = class_list[index];
+		class_ptr->num_entries = 0;
+		class_ptr->total_size = 0;
+		class_ptr->total_blocks = 0;
+		for ( slot = first_slot ; slot < last_slot ; ++slot ) {
+			class_ptr->num_entries += class_ptr->thread_counts[slot].num_entries;
+			class_ptr->total_size += class_ptr->thread_counts[slot].total_size;
+			class_ptr->total_blocks += class_ptr->thread_counts[slot].total_blocks;
+		} /* FOR over threads */
+	} /* FOR over classes */
+
+	return;
+} /* end of merge_counts */
+
+/*********************************************************************
+*
+* Function  : dump_class
+*
+* Purpose   : Display the contents of the specified class structure.
+*
+* Inputs    : fp - stream to receive the display
+*             class_ptr - pointer to class structure
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : dump_class(stdout,&dir_class);
+*
+* Notes     : With -s the apparent size and the disk space used are
+*             also shown , the latter in Kb like du.
+*
+*********************************************************************/
+
+void dump_class(FILE *fp, FILECLASS *class_ptr)
+{
+	if ( opt_s ) {
+		fprintf(fp,"%-24.24s [%d] %lld bytes , %lld Kb used\n",class_ptr->class_title,
+				class_ptr->num_entries,class_ptr->total_size,
+				class_ptr->total_blocks / 2);
+	} /* IF */
+	else {
+		fprintf(fp,"%-24.24s [%d]\n",class_ptr->class_title, class_ptr->num_entries);
+	} /* ELSE */
+
+	return;
+} /* end of dump_class */
+
+/*********************************************************************
+*
+* Function  : dump_counts
+*
+* Purpose   : Display the merged counts of all the classes.
+*
+* Inputs    : fp - stream to receive the display
+*
+* Output    : counts
+*
+* Returns   : (nothing)
+*
+* Example   : dump_counts(stdout);
+*
+* Notes     : A Total line follows with -s or in watch mode.
+*
+*********************************************************************/
+
+void dump_counts(FILE *fp)
+{
+	int		index;
+
+	for ( index = 0 ; index < num_classes ; ++index ) {
+		dump_class(fp,class_list[index]);
+	} /* FOR */
+	if ( opt_s || opt_w ) {
+		total_class.num_entries = 0;
+		total_class.total_size = 0;
+		total_class.total_blocks = 0;
+		for ( index = 0 ; index < num_classes ; ++index ) {
+			total_class.num_entries += class_list[index]->num_entries;
+			total_class.total_size += class_list[index]->total_size;
+			total_class.total_blocks += class_list[index]->total_blocks;
+		} /* FOR */
+		dump_class(fp,&total_class);
+	} /* IF */
+
+	return;
+} /* end of dump_counts */
+
+/*********************************************************************
+*
+* Function  : sample_frontier
+*
+* Purpose   : Count a random sample of the subtrees below the
+*             enumerated levels (-a).
+*
+* Inputs    : start - time at which the scan was started
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : sample_frontier(start);
+*
+* Notes     : Subtrees are drawn without replacement and each one is
+*             counted completely. Sampling stops when the sample or time
+*             budget is used up or every subtree has been counted. The
+*             budgets are only checked between subtrees , since
+*             abandoning a large subtree part way would bias the
+*             estimate downwards ; use more levels if single subtrees
+*             are too big to count in the time budget.
+*
+*********************************************************************/
+
+void sample_frontier(double start)
+{
+	int		index , pick , before[NUM_CLASSES];
+	double	count , total , delta;
+	char	*path;
+
+	merge_counts(-1);
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		top_counts[index] = class_list[index]->num_entries;
+	} /* FOR */
+	memset(estimates,0,sizeof(estimates));
+	srandom(time(NULL) ^ getpid());
+	collect_frontier = 0;
+
+	for ( num_samples = 0 ; num_samples < frontier_count ; ++num_samples ) {
+		if ( num_samples >= max_samples || (num_samples > 1 && now_secs() - start > max_secs) ) {
+			break;
+		} /* IF budget is used up */
+		pick = num_samples + random() % (frontier_count - num_samples);
+		path = frontier[pick];
+		frontier[pick] = frontier[num_samples];
+		frontier[num_samples] = path;
+
+		for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+			before[index] = class_list[index]->num_entries;
+		} /* FOR */
+		traverse_tree(&path,1,NULL,approx_levels);
+		merge_counts(-1);
+		total = 0;
+		for ( index = 0 ; index <= NUM_CLASSES ; ++index ) {
+			if ( index < NUM_CLASSES ) {
+				count = class_list[index]->num_entries - before[index];
+				total += count;
+			} /* IF */
+			else {
+				count = total;
+			} /* ELSE */
+			delta = count - estimates[index].mean;
+			estimates[index].mean += delta / (num_samples + 1);
+			estimates[index].sum_squares += delta * (count - estimates[index].mean);
+		} /* FOR over classes and the total */
+	} /* FOR over sampled subtrees */
+
+	return;
+} /* end of sample_frontier */
+
+/*********************************************************************
+*
+* Function  : dump_estimate
+*
+* Purpose   : Display the estimated count of one class (-a).
+*
+* Inputs    : title - title of the class
+*             top_count - exact count within the enumerated levels
+*             estimate - statistics of the sampled subtrees
+*
+* Output    : estimate with its 95% confidence interval
+*
+* Returns   : (nothing)
+*
+* Example   : dump_estimate(dir_class.class_title,top_counts[1],&estimates[1]);
+*
+* Notes     : The sampled subtree counts are scaled up to all the
+*             subtrees , with the finite population correction applied
+*             to the standard error. The interval uses the normal
+*             approximation , so it is rough for a handful of samples.
+*
+*********************************************************************/
+
+void dump_estimate(char *title, int top_count, ESTIMATE *estimate)
+{
+	double	value , error;
+
+	value = top_count;
+	error = 0;
+	if ( num_samples > 0 ) {
+		value += frontier_count * estimate->mean;
+		if ( num_samples > 1 ) {
+			error = 1.96 * frontier_count * sqrt((1.0 - (double)num_samples / frontier_count) *
+						estimate->sum_squares / (num_samples - 1) / num_samples);
+		} /* IF */
+	} /* IF */
+	fprintf(stdout,"%-24.24s [~%.0f +/- %.0f]\n",title,value,error);
+
+	return;
+} /* end of dump_estimate */
+
+/*********************************************************************
+*
+* Function  : dump_estimates
+*
+* Purpose   : Display the estimated counts of all the classes (-a).
+*
+* Inputs    : elapsed - elapsed time of the scan
+*
+* Output    : estimates
+*
+* Returns   : (nothing)
+*
+* Example   : dump_estimates(elapsed);
+*
+* Notes     : If every subtree was counted the estimates are exact and
+*             their intervals are 0.
+*
+*********************************************************************/
+
+void dump_estimates(double elapsed)
+{
+	int		index , top_total;
+
+	top_total = 0;
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		dump_estimate(class_list[index]->class_title,top_counts[index],&estimates[index]);
+		top_total += top_counts[index];
+	} /* FOR */
+	dump_estimate(total_class.class_title,top_total,&estimates[NUM_CLASSES]);
+	printf("\nEstimated from %d of %d subtrees below depth %d in %.1f secs (95%% intervals)\n",
+			num_samples,frontier_count,approx_levels,elapsed);
+	if ( num_samples == 0 && frontier_count > 0 ) {
+		printf("No subtree was sampled , counts are for the top %d levels only\n",approx_levels);
+	} /* IF */
+
+	return;
+} /* end of dump_estimates */
+
+/*********************************************************************
+*
+* Function  : compare_heavy
+*
+* Purpose   : Compare two directories for qsort() , heaviest first.
+*
+* Inputs    : ptr1 - pointer to first directory
+*             ptr2 - pointer to second directory
+*
+* Output    : (none)
+*
+* Returns   : <0 , 0 , >0
+*
+* Example   : qsort(dirs,count,sizeof(HEAVYDIR),compare_heavy);
+*
+* Notes     : Ties are ordered by path so that the report is stable.
+*
+*********************************************************************/
+
+int compare_heavy(const void *ptr1, const void *ptr2)
+{
+	HEAVYDIR	*dir1 , *dir2;
+
+	dir1 = (HEAVYDIR *)ptr1;
+	dir2 = (HEAVYDIR *)ptr2;
+	if ( dir1->count != dir2->count ) {
+		return( (dir1->count < dir2->count) - (dir1->count > dir2->count) );
+	} /* IF */
+
+	return(strcmp(dir1->path,dir2->path));
+} /* end of compare_heavy */
+
+/*********************************************************************
+*
+* Function  : dump_heavy
+*
+* Purpose   : Display one ranking of the heaviest directories (-D).
+*
+* Inputs    : heaps - per thread heaps of the ranking
+*             title - title of the ranking
+*
+* Output    : ranked report
+*
+* Returns   : (nothing)
+*
+* Example   : dump_heavy(heavy_direct,"direct entries");
+*
+* Notes     : The per thread heaps are merged , each may hold any of
+*             the overall top directories.
+*
+*********************************************************************/
+
+void dump_heavy(HEAVYHEAP *heaps, char *title)
+{
+	HEAVYDIR	*dirs;
+	int		thread_num , index , count;
+
+	dirs = (HEAVYDIR *)malloc(num_threads * heavy_n * sizeof(HEAVYDIR));
+	if ( dirs == NULL ) {
+		quit(1,"malloc failed for heaviest directories");
+	} /* IF */
+	count = 0;
+	for ( thread_num = 0 ; thread_num < num_threads ; ++thread_num ) {
+		for ( index = 0 ; index < heaps[thread_num].count ; ++index ) {
+			dirs[count++] = heaps[thread_num].dirs[index];
+		} /* FOR */
+	} /* FOR */
+	qsort(dirs,count,sizeof(HEAVYDIR),compare_heavy);
+
+	printf("\nTop %d directories by %s\n\n",heavy_n,title);
+	printf("Rank  %12s  Directory\n","Entries");
+	for ( index = 0 ; index < count && index < heavy_n ; ++index ) {
+		printf("%4d  %12ld  %s\n",index + 1,dirs[index].count,dirs[index].path);
+	} /* FOR */
+	free(dirs);
+
+	return;
+} /* end of dump_heavy */
+
+/*********************************************************************
+*
+* Function  : watch_path
+*
+* Purpose   : Build the path of a watched directory.
+*
+* Inputs    : node - node of the directory
+*             buffer - buffer to receive the path
+*             size - size of buffer
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : watch_path(node,path,sizeof(path));
+*
+* Notes     : Paths are built from the names in the tree so that a
+*             renamed directory needs only its own node updated.
+*
+*********************************************************************/
+
+void watch_path(WATCHDIR *node, char *buffer, int size)
+{
+	int		length;
+
+	if ( node->parent == NULL ) {
+		snprintf(buffer,size,"%s",node->name);
+		return;
+	} /* IF */
+	watch_path(node->parent,buffer,size);
+	length = strlen(buffer);
+	snprintf(buffer + length,size - length,"/%s",node->name);
+
+	return;
+} /* end of watch_path */
+
+/*********************************************************************
+*
+* Function  : adjust_count
+*
+* Purpose   : Change the count of a class in a watched directory.
+*
+* Inputs    : node - node of the directory
+*             class_index - class to be changed
+*             delta - amount of change
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : adjust_count(node,1,-1);
+*
+* Notes     : Counts are never taken below zero , which can happen
+*             when an entry is removed before its creation was seen.
+*
+*********************************************************************/
+
+void adjust_count(WATCHDIR *node, int class_index, int delta)
+{
+	if ( node->num_entries[class_index] + delta < 0 ) {
+		delta = -node->num_entries[class_index];
+	} /* IF */
+	node->num_entries[class_index] += delta;
+	class_list[class_index]->thread_counts[0].num_entries += delta;
+
+	return;
+} /* end of adjust_count */
+
+/*********************************************************************
+*
+* Function  : take_child
+*
+* Purpose   : Find a subdirectory node and unlink it from its parent.
+*
+* Inputs    : node - node of the parent directory
+*             name - name of the subdirectory
+*
+* Output    : (none)
+*
+* Returns   : pointer to child node , NULL if not found
+*
+* Example   : child = take_child(node,event->name);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+WATCHDIR *take_child(WATCHDIR *node, char *name)
+{
+	WATCHDIR	**link , *child;
 
-int	opt_d = 0 , opt_h = 0;
-char	*progname;
+	for ( link = &node->children ; (child = *link) != NULL ; link = &child->next_sibling ) {
+		if ( EQ(child->name,name) ) {
+			*link = child->next_sibling;
+			child->next_sibling = NULL;
+			child->parent = NULL;
+			return(child);
+		} /* IF */
+	} /* FOR */
 
-extern	int	optind , optopt , opterr;
-extern	void	system_error() , die() , quit();
+	return(NULL);
+} /* end of take_child */
 
 /*********************************************************************
 *
-* Function  : usage
+* Function  : take_special
 *
-* Purpose   : Display a brief help summary
+* Purpose   : Find and forget a remembered special entry.
 *
-* Inputs    : (none)
+* Inputs    : node - node of the directory
+*             name - name of the entry
 *
 * Output    : (none)
 *
-* Returns   : (nothing)
+* Returns   : class of the entry , regular files if not remembered
 *
-* Example   : usage()
+* Example   : class_index = take_special(node,event->name);
 *
 * Notes     : (none)
 *
 *********************************************************************/
 
-void usage()
+int take_special(WATCHDIR *node, char *name)
 {
-	fprintf(stderr,"Usage : %s [-dh]\n",progname);
+	SPECIAL	**link , *special;
+	int		class_index;
 
-	return;
-} /* end of usage */
+	for ( link = &node->specials ; (special = *link) != NULL ; link = &special->next ) {
+		if ( EQ(special->name,name) ) {
+			*link = special->next;
+			class_index = special->class_index;
+			free(special);
+			return(class_index);
+		} /* IF */
+	} /* FOR */
+
+	return(0);
+} /* end of take_special */
 
 /*********************************************************************
 *
-* Function  : add_to_class
+* Function  : drop_subtree
 *
-* Purpose   : Add the specified unqualified filename to the specified
-*             class.
+* Purpose   : Remove a directory tree from the watch , subtracting all
+*             of its counts.
 *
-* Inputs    : class_ptr - pointer to class structure
+* Inputs    : node - node of the top directory , already unlinked
 *
 * Output    : (none)
 *
 * Returns   : (nothing)
 *
-* Example   : add_to_class(&dir_class,filename);
+* Example   : drop_subtree(child);
 *
 * Notes     : (none)
 *
 *********************************************************************/
 
-void add_to_class(FILECLASS *class_ptr)
+void drop_subtree(WATCHDIR *node)
 {
-	int		namelen , new_size;
+	WATCHDIR	*child , *next_child , **link;
+	SPECIAL	*special , *next_special;
+	int		index;
 
-	class_ptr->num_entries += 1;
+	for ( child = node->children ; child != NULL ; child = next_child ) {
+		next_child = child->next_sibling;
+		drop_subtree(child);
+	} /* FOR */
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		adjust_count(node,index,-node->num_entries[index]);
+	} /* FOR */
+	for ( special = node->specials ; special != NULL ; special = next_special ) {
+		next_special = special->next;
+		free(special);
+	} /* FOR */
+	if ( node->wd >= 0 ) {
+		inotify_rm_watch(inotify_fd,node->wd);
+		watch_table[node->wd] = NULL;
+	} /* IF */
+	if ( node->dirty ) {
+		for ( link = &dirty_list ; *link != node ; link = &(*link)->next_dirty ) {
+			;
+		} /* FOR */
+		*link = node->next_dirty;
+	} /* IF */
+	free(node->name);
+	free(node);
 
 	return;
-} /* end of add_to_class */
+} /* end of drop_subtree */
 
 /*********************************************************************
 *
-* Function  : process_dir
+* Function  : recount_dir
 *
-* Purpose   : Process a directory
+* Purpose   : Recount the entries held directly in a watched directory.
 *
-* Inputs    : char *dirname - directory name
+* Inputs    : node - node of the directory
 *
-* Output    : appropriate messages
+* Output    : (none)
 *
 * Returns   : (nothing)
 *
-* Example   : process_dir(".")
+* Example   : recount_dir(node);
 *
-* Notes     : (none)
+* Notes     : A file renamed over an existing one removes the old file
+*             without a delete event , so after a move into a directory
+*             its own entries are counted again. Subdirectories are not
+*             descended into. This is deferred until no events are
+*             waiting (see mark_dirty()) , otherwise the directory could
+*             already reflect events which are still to be handled.
 *
 *********************************************************************/
 
-void process_dir(char *dirname)
+void recount_dir(WATCHDIR *node)
 {
-	DIR	*dirptr;
-	char	filepath[MAXPATHLEN] , *string;
+	char	path[MAXPATHLEN];
+	DIR		*dirptr;
 	struct dirent	*entry;
 	struct stat	filestats;
 	mode_t	filemode;
-	FILECLASS	*class_ptr;
-	char	*subdirs[MAX_DIRS];
-	int		num_subdirs = 0;
-	int		index;
+	int		index , counts[NUM_CLASSES];
+	SPECIAL	*special;
 
-	dirptr = opendir(dirname);
+	watch_path(node,path,sizeof(path));
+	dirptr = opendir(path);
 	if ( dirptr == NULL ) {
-		quit(1,"opendir failed for '%s'",dirname);
-	}
-
-	entry = readdir(dirptr);
-	for ( ; entry != NULL ; entry = readdir(dirptr) ) {
-		sprintf(filepath,"%s/%s",dirname,entry->d_name);
+		return;
+	} /* IF */
+	while ( (special = node->specials) != NULL ) {
+		node->specials = special->next;
+		free(special);
+	} /* WHILE */
+	memset(counts,0,sizeof(counts));
+	while ( (entry = readdir(dirptr)) != NULL ) {
 		if ( EQ(entry->d_name,".") || EQ(entry->d_name,"..") ) {
 			continue;
-		} /* skip over '.' and '..' */
-		if ( lstat(filepath,&filestats) == 0 ) {
+		} /* IF */
+		filemode = dtype_to_mode(entry->d_type);
+		if ( filemode == 0 ) {
+			if ( fstatat(dirfd(dirptr),entry->d_name,&filestats,AT_SYMLINK_NOFOLLOW) < 0 ) {
+				continue;
+			} /* IF */
 			filemode = filestats.st_mode & S_IFMT;
-			switch ( filemode ) {
-			case S_IFDIR:
-				add_to_class(&dir_class);
-				if ( num_subdirs >= MAX_DIRS ) {
-					die(1,"Limit of %d subdirs exceeded under '%s'\n",MAX_DIRS,dirname);
-				} /* IF */
-				subdirs[num_subdirs] = strdup(filepath);
-				if ( subdirs[num_subdirs] == NULL ) {
-					quit(1,"strdup failed");
-				} /* IF */
-				num_subdirs += 1;
-				break;
-			case S_IFREG:
-				add_to_class(&regular_class);
-				break;
-			case S_IFBLK:
-				add_to_class(&block_class);
-				break;
-			case S_IFCHR:
-				add_to_class(&char_class);
-				break;
-			case S_IFIFO:
-				add_to_class(&pipe_class);
-				break;
-			case S_IFLNK:
-				add_to_class(&symlink_class);
-				break;
-			case S_IFSOCK:
-				add_to_class(&socket_class);
-				break;
-			default:
-				fprintf(stderr,"Unexpected mode %o for %s\n", filemode,entry->d_name);
-				add_to_class(&misc_class);
-			} /* end of SWITCH */
-		} /* IF lstat succeeded */
-		else {
-			system_error("lstat failed for '%s'",filepath);
-		} /* ELSE lstat failed */
-	} /* FOR loop over directory entries */
+		} /* IF */
+		index = mode_to_class(filemode);
+		counts[index] += 1;
+		if ( filemode != S_IFREG && filemode != S_IFDIR ) {
+			add_special(node,index,entry->d_name);
+		} /* IF */
+	} /* WHILE */
 	closedir(dirptr);
-	for ( index = 0 ; index < num_subdirs ; ++index ) {
-		process_dir(subdirs[index]);
-	}
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		adjust_count(node,index,counts[index] - node->num_entries[index]);
+	} /* FOR */
 
 	return;
-} /* end of process_dir */
+} /* end of recount_dir */
 
 /*********************************************************************
 *
-* Function  : dump_class
+* Function  : mark_dirty
 *
-* Purpose   : Display the contents of the specified class structure.
+* Purpose   : Schedule a watched directory to be recounted.
 *
-* Inputs    : class_ptr - pointer to class structure
+* Inputs    : node - node of the directory
 *
 * Output    : (none)
 *
 * Returns   : (nothing)
 *
-* Example   : dump_class(&dir_class);
+* Example   : mark_dirty(to_node);
 *
 * Notes     : (none)
 *
 *********************************************************************/
 
-void dump_class(FILECLASS *class_ptr)
+void mark_dirty(WATCHDIR *node)
 {
-	printf("%-24.24s [%d]\n",class_ptr->class_title, class_ptr->num_entries);
+	if ( ! node->dirty ) {
+		node->dirty = 1;
+		node->next_dirty = dirty_list;
+		dirty_list = node;
+	} /* IF */
 
 	return;
-} /* end of dump_class */
+} /* end of mark_dirty */
+
+/*********************************************************************
+*
+* Function  : recount_dirty
+*
+* Purpose   : Recount all the directories scheduled by mark_dirty().
+*
+* Inputs    : (none)
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : recount_dirty();
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void recount_dirty()
+{
+	WATCHDIR	*node;
+
+	while ( (node = dirty_list) != NULL ) {
+		dirty_list = node->next_dirty;
+		node->dirty = 0;
+		node->next_dirty = NULL;
+		recount_dir(node);
+	} /* WHILE */
+
+	return;
+} /* end of recount_dirty */
+
+/*********************************************************************
+*
+* Function  : entry_added
+*
+* Purpose   : Count an entry created in , or moved into , a watched
+*             directory.
+*
+* Inputs    : node - node of the directory
+*             name - name of the new entry
+*             is_dir - non-zero if inotify flagged the entry as a directory
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : entry_added(node,event->name,event->mask & IN_ISDIR);
+*
+* Notes     : A new directory is scanned (and watched) in full , since
+*             entries may have been created in it before its watch was
+*             in place. An entry which is already gone again is counted
+*             as entry_removed() will uncount it , as a directory or else
+*             as a regular file.
+*
+*********************************************************************/
+
+void entry_added(WATCHDIR *node, char *name, int is_dir)
+{
+	char	path[MAXPATHLEN] , *pathptr;
+	struct stat	filestats;
+	int		index;
+	WATCHDIR	*child;
+
+	watch_path(node,path,sizeof(path));
+	snprintf(path + strlen(path),sizeof(path) - strlen(path),"/%s",name);
+	if ( lstat(path,&filestats) < 0 ) {
+		filestats.st_mode = is_dir ? S_IFDIR : S_IFREG;
+	} /* IF already gone again */
+	index = mode_to_class(filestats.st_mode & S_IFMT);
+	if ( S_ISDIR(filestats.st_mode) ) {
+		child = take_child(node,name);
+		if ( child != NULL ) {
+			drop_subtree(child);
+		} /* IF stale node of the same name */
+		else {
+			adjust_count(node,index,1);
+		} /* ELSE */
+		if ( ! skip_subdir(AT_FDCWD,name,path,node->depth + 1,0) ) {
+			child = new_watch_node(node,name);
+			pathptr = path;
+			traverse_tree(&pathptr,1,child,child->depth);
+		} /* IF not pruned */
+	} /* IF */
+	else {
+		adjust_count(node,index,1);
+		if ( index != 0 ) {
+			add_special(node,index,name);
+		} /* IF */
+	} /* ELSE */
+
+	return;
+} /* end of entry_added */
+
+/*********************************************************************
+*
+* Function  : entry_removed
+*
+* Purpose   : Uncount an entry deleted from , or moved out of , a
+*             watched directory.
+*
+* Inputs    : node - node of the directory
+*             name - name of the entry
+*             is_dir - non-zero if the entry is a directory
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : entry_removed(node,event->name,event->mask & IN_ISDIR);
+*
+* Notes     : A directory moved out of the tree takes all of its
+*             counts with it.
+*
+*********************************************************************/
+
+void entry_removed(WATCHDIR *node, char *name, int is_dir)
+{
+	WATCHDIR	*child;
+
+	if ( is_dir ) {
+		child = take_child(node,name);
+		if ( child != NULL ) {
+			drop_subtree(child);
+		} /* IF */
+		adjust_count(node,1,-1);
+	} /* IF */
+	else {
+		adjust_count(node,take_special(node,name),-1);
+	} /* ELSE */
+
+	return;
+} /* end of entry_removed */
+
+/*********************************************************************
+*
+* Function  : entry_moved
+*
+* Purpose   : Move an entry between (or within) watched directories.
+*
+* Inputs    : from_node - node of the old directory
+*             from_name - old name
+*             to_node - node of the new directory
+*             to_name - new name
+*             is_dir - non-zero if the entry is a directory
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : entry_moved(from_node,from_name,node,event->name,1);
+*
+* Notes     : A moved directory keeps its node , counts and watches ;
+*             only its name and parent change. A moved file may have
+*             replaced another , so its new directory is recounted.
+*
+*********************************************************************/
+
+void entry_moved(WATCHDIR *from_node, char *from_name, WATCHDIR *to_node,
+					char *to_name, int is_dir)
+{
+	WATCHDIR	*child , *replaced;
+	int		class_index;
+
+	if ( ! is_dir ) {
+		class_index = take_special(from_node,from_name);
+		adjust_count(from_node,class_index,-1);
+		adjust_count(to_node,class_index,1);
+		if ( class_index != 0 ) {
+			add_special(to_node,class_index,to_name);
+		} /* IF */
+		mark_dirty(to_node);
+		return;
+	} /* IF */
+
+	child = take_child(from_node,from_name);
+	if ( child == NULL ) {
+		adjust_count(from_node,1,-1);
+		entry_added(to_node,to_name,1);
+		return;
+	} /* IF directory was not known */
+	replaced = take_child(to_node,to_name);
+	if ( replaced != NULL ) {
+		drop_subtree(replaced);
+		adjust_count(to_node,1,-1);
+	} /* IF an empty directory was replaced */
+	adjust_count(from_node,1,-1);
+	adjust_count(to_node,1,1);
+	free(child->name);
+	child->name = strdup(to_name);
+	if ( child->name == NULL ) {
+		quit(1,"strdup failed");
+	} /* IF */
+	child->parent = to_node;
+	child->next_sibling = to_node->children;
+	to_node->children = child;
+
+	return;
+} /* end of entry_moved */
+
+/*********************************************************************
+*
+* Function  : rescan_tree
+*
+* Purpose   : Throw away all the counts and watches and scan the whole
+*             tree again.
+*
+* Inputs    : (none)
+*
+* Output    : a warning
+*
+* Returns   : (nothing)
+*
+* Example   : rescan_tree();
+*
+* Notes     : Only used when the kernel's event queue overflowed and
+*             events have been lost.
+*
+*********************************************************************/
+
+void rescan_tree()
+{
+	char	*root_name;
+	int		index;
+
+	fprintf(stderr,"inotify event queue overflowed , rescanning\n");
+	root_name = strdup(watch_root->name);
+	if ( root_name == NULL ) {
+		quit(1,"strdup failed");
+	} /* IF */
+	drop_subtree(watch_root);
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		memset(class_list[index]->thread_counts,0,num_roots * num_threads * sizeof(CLASSCOUNTS));
+	} /* FOR */
+	watch_root = new_watch_node(NULL,root_name);
+	free(root_name);
+	traverse_tree(&watch_root->name,1,watch_root,0);
+
+	return;
+} /* end of rescan_tree */
+
+/*********************************************************************
+*
+* Function  : handle_event
+*
+* Purpose   : Update the counters for one inotify event.
+*
+* Inputs    : event - the event
+*             moved_from - pointer to the pending IN_MOVED_FROM event ,
+*                          updated as moves are paired
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : handle_event(event,&moved_from);
+*
+* Notes     : An IN_MOVED_FROM is held until the next event. If that is
+*             the matching IN_MOVED_TO the entry was moved within the
+*             tree , otherwise it left the tree. The pending event is
+*             a copy since the read buffer is reused.
+*
+*********************************************************************/
+
+void handle_event(struct inotify_event *event, struct inotify_event **moved_from)
+{
+	WATCHDIR	*node , *from_node;
+	struct inotify_event	*pending;
+
+	pending = *moved_from;
+	if ( event == NULL || ! (event->mask & IN_MOVED_TO) || pending == NULL ||
+				event->cookie != pending->cookie ) {
+		if ( pending != NULL ) {
+			from_node = (pending->wd < watch_table_size) ? watch_table[pending->wd] : NULL;
+			if ( from_node != NULL ) {
+				entry_removed(from_node,pending->name,pending->mask & IN_ISDIR);
+			} /* IF */
+			free(pending);
+			*moved_from = pending = NULL;
+		} /* IF a move out of the tree */
+	} /* IF */
+	if ( event == NULL ) {
+		return;
+	} /* IF only flushing the pending move */
+
+	if ( event->mask & IN_Q_OVERFLOW ) {
+		rescan_tree();
+		return;
+	} /* IF */
+	node = (event->wd >= 0 && event->wd < watch_table_size) ? watch_table[event->wd] : NULL;
+	if ( node == NULL ) {
+		return;
+	} /* IF not (or no longer) watched */
+	if ( event->mask & IN_IGNORED ) {
+		watch_table[event->wd] = NULL;
+		node->wd = -1;
+		return;
+	} /* IF watch was removed */
+
+	if ( event->mask & IN_CREATE ) {
+		entry_added(node,event->name,event->mask & IN_ISDIR);
+	} /* IF */
+	else if ( event->mask & IN_DELETE ) {
+		entry_removed(node,event->name,event->mask & IN_ISDIR);
+	} /* ELSE IF */
+	else if ( event->mask & IN_MOVED_FROM ) {
+		*moved_from = (struct inotify_event *)malloc(sizeof(struct inotify_event) + event->len);
+		if ( *moved_from == NULL ) {
+			quit(1,"malloc failed for pending move");
+		} /* IF */
+		memcpy(*moved_from,event,sizeof(struct inotify_event) + event->len);
+	} /* ELSE IF */
+	else if ( event->mask & IN_MOVED_TO ) {
+		if ( pending != NULL ) {
+			from_node = (pending->wd < watch_table_size) ? watch_table[pending->wd] : NULL;
+			if ( from_node != NULL ) {
+				entry_moved(from_node,pending->name,node,event->name,
+							event->mask & IN_ISDIR);
+			} /* IF */
+			else {
+				entry_added(node,event->name,event->mask & IN_ISDIR);
+			} /* ELSE */
+			free(pending);
+			*moved_from = NULL;
+		} /* IF a move within the tree */
+		else {
+			entry_added(node,event->name,event->mask & IN_ISDIR);
+			if ( ! (event->mask & IN_ISDIR) ) {
+				mark_dirty(node);
+			} /* IF a file moved in , maybe over an existing one */
+		} /* ELSE */
+	} /* ELSE IF */
+
+	return;
+} /* end of handle_event */
+
+/*********************************************************************
+*
+* Function  : serve_counts
+*
+* Purpose   : Send the current counts to a client of the watch socket.
+*
+* Inputs    : listen_fd - the listening socket
+*
+* Output    : counts written to the client
+*
+* Returns   : (nothing)
+*
+* Example   : serve_counts(listen_fd);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void serve_counts(int listen_fd)
+{
+	int		client_fd;
+	FILE	*fp;
+
+	client_fd = accept(listen_fd,NULL,NULL);
+	if ( client_fd < 0 ) {
+		return;
+	} /* IF */
+	fp = fdopen(client_fd,"w");
+	if ( fp == NULL ) {
+		close(client_fd);
+		return;
+	} /* IF */
+	merge_counts(-1);
+	dump_counts(fp);
+	fclose(fp);
+
+	return;
+} /* end of serve_counts */
+
+/*********************************************************************
+*
+* Function  : catch_signal
+*
+* Purpose   : Stop watching when the program is interrupted.
+*
+* Inputs    : signum - signal number
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : signal(SIGINT,catch_signal);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void catch_signal(int signum)
+{
+	stop_watching = 1;
+
+	return;
+} /* end of catch_signal */
+
+/*********************************************************************
+*
+* Function  : watch_tree
+*
+* Purpose   : Keep the counters current from inotify events and serve
+*             them on a local socket (-w).
+*
+* Inputs    : (none)
+*
+* Output    : counts written to each client of the socket
+*
+* Returns   : (nothing)
+*
+* Example   : watch_tree();
+*
+* Notes     : Runs until interrupted. Each connection to the socket
+*             receives the current counts and is closed , eg.
+*             socat - UNIX-CONNECT:socket_path
+*
+*********************************************************************/
+
+void watch_tree()
+{
+	int		listen_fd , count , timeout;
+	struct sockaddr_un	address;
+	struct pollfd	fds[2];
+	char	*buffer , *ptr;
+	struct inotify_event	*event , *moved_from;
+	ssize_t	length;
+	struct sigaction	action;
+
+	buffer = (char *)malloc(EVENT_BUFFER_SIZE);
+	if ( buffer == NULL ) {
+		quit(1,"malloc failed for event buffer");
+	} /* IF */
+	listen_fd = socket(AF_UNIX,SOCK_STREAM | SOCK_CLOEXEC,0);
+	if ( listen_fd < 0 ) {
+		quit(1,"socket failed");
+	} /* IF */
+	memset(&address,0,sizeof(address));
+	address.sun_family = AF_UNIX;
+	if ( strlen(socket_path) >= sizeof(address.sun_path) ) {
+		die(1,"Socket path '%s' is too long\n",socket_path);
+	} /* IF */
+	strcpy(address.sun_path,socket_path);
+	unlink(socket_path);
+	if ( bind(listen_fd,(struct sockaddr *)&address,sizeof(address)) < 0 ||
+				listen(listen_fd,16) < 0 ) {
+		quit(1,"Can't listen on socket '%s'",socket_path);
+	} /* IF */
+
+	memset(&action,0,sizeof(action));
+	action.sa_handler = catch_signal;
+	sigaction(SIGINT,&action,NULL);
+	sigaction(SIGTERM,&action,NULL);
+	signal(SIGPIPE,SIG_IGN);
+
+	fflush(stdout);
+	moved_from = NULL;
+	fds[0].fd = inotify_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = listen_fd;
+	fds[1].events = POLLIN;
+	while ( ! stop_watching ) {
+		timeout = (moved_from != NULL || dirty_list != NULL) ? SETTLE_MSECS : -1;
+		count = poll(fds,2,timeout);
+		if ( count < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			} /* IF */
+			quit(1,"poll failed");
+		} /* IF */
+		if ( count == 0 ) {
+			handle_event(NULL,&moved_from);
+			recount_dirty();
+			continue;
+		} /* IF events have settled */
+		if ( fds[0].revents & POLLIN ) {
+			length = read(inotify_fd,buffer,EVENT_BUFFER_SIZE);
+			for ( ptr = buffer ; length > 0 && ptr < buffer + length ;
+						ptr += sizeof(struct inotify_event) + event->len ) {
+				event = (struct inotify_event *)ptr;
+				handle_event(event,&moved_from);
+			} /* FOR over events */
+		} /* IF */
+		if ( fds[1].revents & POLLIN ) {
+			serve_counts(listen_fd);
+		} /* IF */
+	} /* WHILE */
+	close(listen_fd);
+	unlink(socket_path);
+	free(buffer);
+
+	return;
+} /* end of watch_tree */
 
 /*********************************************************************
 *
@@ -236,7 +4107,7 @@ void dump_class(FILECLASS *class_ptr)
 *
 * Output    : (none)
 *
-* Returns   : (nothing)
+* Returns   : 0 --> success , 1 --> a directory or entry could not be read
 *
 * Example   : lc -a ~/test
 *
@@ -255,12 +4126,15 @@ int main(int argc,char *argv[])
 	int		errcode , count;
 	char	errmsg[256];
 	FILECLASS	*class_ptr;
+	int		index;
+	pthread_t	progress_thread;
+	double	start , elapsed;
 
 	progname = argv[0];
 	anytypes = 0;
 
 	errflag = 0;
-	while ( (opt = getopt(argc,argv,":dh")) != -1 ) {
+	while ( (opt = getopt(argc,argv,":dhsebxpSULn:i:w:m:X:T:a:c:t:D:")) != -1 ) {
 		switch (opt) {
 		case 'h':
 			opt_h = 1;
@@ -268,6 +4142,98 @@ int main(int argc,char *argv[])
 		case 'd':
 			opt_d = 1;
 			break;
+		case 's':
+			opt_s = 1;
+			break;
+		case 'e':
+			opt_e = 1;
+			break;
+		case 'b':
+			opt_b = 1;
+			break;
+		case 'i':
+			opt_i = 1;
+			snapshot_path = optarg;
+			break;
+		case 'w':
+			opt_w = 1;
+			socket_path = optarg;
+			break;
+		case 'U':
+			opt_U = 1;
+			break;
+		case 'L':
+			opt_L = 1;
+			break;
+		case 'D':
+			heavy_n = atoi(optarg);
+			if ( heavy_n < 1 ) {
+				fprintf(stderr,"Number of directories to report must be at least 1\n");
+				errflag += 1;
+			} /* IF */
+			break;
+		case 'x':
+			opt_x = 1;
+			break;
+		case 'p':
+			opt_p = 1;
+			break;
+		case 'S':
+			opt_S = 1;
+			break;
+		case 'a':
+			approx_levels = atoi(optarg);
+			if ( approx_levels < 1 ) {
+				fprintf(stderr,"Number of levels to enumerate must be at least 1\n");
+				errflag += 1;
+			} /* IF */
+			break;
+		case 'c':
+			max_samples = atoi(optarg);
+			if ( max_samples < 1 ) {
+				fprintf(stderr,"Number of samples must be at least 1\n");
+				errflag += 1;
+			} /* IF */
+			break;
+		case 't':
+			max_secs = atof(optarg);
+			if ( max_secs <= 0 ) {
+				fprintf(stderr,"Time budget must be positive\n");
+				errflag += 1;
+			} /* IF */
+			break;
+		case 'm':
+			max_depth = atoi(optarg);
+			if ( max_depth < 0 ) {
+				fprintf(stderr,"Maximum depth can't be negative\n");
+				errflag += 1;
+			} /* IF */
+			break;
+		case 'X':
+			if ( num_skip_patterns >= MAX_SKIP_PATTERNS ) {
+				fprintf(stderr,"Too many skip patterns , limit is %d\n",MAX_SKIP_PATTERNS);
+				errflag += 1;
+			} /* IF */
+			else {
+				skip_patterns[num_skip_patterns++] = optarg;
+			} /* ELSE */
+			break;
+		case 'n':
+			top_n = atoi(optarg);
+			if ( top_n < 1 ) {
+				fprintf(stderr,"Number of extensions to display must be at least 1\n");
+				errflag += 1;
+			} /* IF */
+			break;
+		case 'T':
+			num_threads = atoi(optarg);
+			threads_given = 1;
+			if ( num_threads < 1 || num_threads > MAX_THREADS ) {
+				fprintf(stderr,"Number of threads must be between 1 and %d\n",
+						MAX_THREADS);
+				errflag += 1;
+			} /* IF */
+			break;
 		case '?':
 			fprintf(stderr,"Unknown option '%c'\n",optopt);
 			errflag += 1;
@@ -282,20 +4248,182 @@ int main(int argc,char *argv[])
 			errflag += 1;
 		} /* SWITCH */
 	} /* WHILE loop over options */
+	if ( opt_i && (opt_s || opt_e) ) {
+		fprintf(stderr,"-i can't be combined with -s or -e\n");
+		errflag += 1;
+	} /* IF */
+	if ( opt_w && (opt_s || opt_e || opt_i) ) {
+		fprintf(stderr,"-w can't be combined with -s , -e or -i\n");
+		errflag += 1;
+	} /* IF */
+	if ( approx_levels > 0 && (opt_s || opt_e || opt_i || opt_w) ) {
+		fprintf(stderr,"-a can't be combined with -s , -e , -i or -w\n");
+		errflag += 1;
+	} /* IF */
+	if ( heavy_n > 0 && (opt_w || approx_levels > 0) ) {
+		fprintf(stderr,"-D can't be combined with -w or -a\n");
+		errflag += 1;
+	} /* IF */
+	if ( opt_L && (opt_w || opt_i) ) {
+		fprintf(stderr,"-L can't be combined with -w or -i\n");
+		errflag += 1;
+	} /* IF */
+	if ( opt_b && ! opt_e ) {
+		fprintf(stderr,"-b requires -e\n");
+		errflag += 1;
+	} /* IF */
+	if ( optind < argc ) {
+		num_roots = argc - optind;
+		root_paths = &argv[optind];
+	} /* IF directories were named */
+	if ( num_roots > 1 && (opt_w || approx_levels > 0) ) {
+		fprintf(stderr,"-w and -a only accept one directory\n");
+		errflag += 1;
+	} /* IF */
 	if ( errflag ) {
 		usage();
 		die(1,"\n%s aborted.\n",argv[0]);
 	}
 
-	process_dir(".");
-	dump_class(&regular_class);
-	dump_class(&dir_class);
-	dump_class(&char_class);
-	dump_class(&block_class);
-	dump_class(&pipe_class);
-	dump_class(&symlink_class);
-	dump_class(&socket_class);
-	dump_class(&misc_class);
-
-	exit(0);
+	if ( ! threads_given && num_roots > 1 ) {
+		num_threads = (num_roots < MAX_THREADS) ? num_roots : MAX_THREADS;
+	} /* IF one thread per root by default */
+	for ( index = 0 ; index < num_classes ; ++index ) {
+		class_ptr = class_list[index];
+		errcode = posix_memalign((void **)&class_ptr->thread_counts,CACHE_LINE_SIZE,
+						num_roots * num_threads * sizeof(CLASSCOUNTS));
+		if ( errcode != 0 ) {
+			die(1,"posix_memalign failed for thread counters : %s\n",strerror(errcode));
+		} /* IF */
+		memset(class_ptr->thread_counts,0,num_roots * num_threads * sizeof(CLASSCOUNTS));
+	} /* FOR */
+	errcode = posix_memalign((void **)&thread_stats,CACHE_LINE_SIZE,
+					num_threads * sizeof(THREADSTATS));
+	if ( errcode != 0 ) {
+		die(1,"posix_memalign failed for thread statistics : %s\n",strerror(errcode));
+	} /* IF */
+	memset(thread_stats,0,num_threads * sizeof(THREADSTATS));
+	if ( opt_e ) {
+		ext_tables = (EXTTABLE *)calloc(num_threads,sizeof(EXTTABLE));
+		if ( ext_tables == NULL ) {
+			quit(1,"calloc failed for extension tables");
+		} /* IF */
+	} /* IF */
+	if ( opt_i ) {
+		snap_buffers = (SNAPBUF *)calloc(num_threads,sizeof(SNAPBUF));
+		if ( snap_buffers == NULL ) {
+			quit(1,"calloc failed for snapshot buffers");
+		} /* IF */
+		load_snapshot();
+	} /* IF */
+	if ( heavy_n > 0 ) {
+		errcode = posix_memalign((void **)&heavy_direct,CACHE_LINE_SIZE,
+						2 * num_threads * sizeof(HEAVYHEAP));
+		if ( errcode != 0 ) {
+			die(1,"posix_memalign failed for directory heaps : %s\n",strerror(errcode));
+		} /* IF */
+		heavy_recursive = heavy_direct + num_threads;
+		for ( index = 0 ; index < 2 * num_threads ; ++index ) {
+			heavy_direct[index].count = 0;
+			heavy_direct[index].dirs = (HEAVYDIR *)malloc(heavy_n * sizeof(HEAVYDIR));
+			if ( heavy_direct[index].dirs == NULL ) {
+				quit(1,"malloc failed for directory heap");
+			} /* IF */
+		} /* FOR */
+	} /* IF */
+	if ( opt_U ) {
+		stat_rings = (STATRING *)calloc(num_threads,sizeof(STATRING));
+		if ( stat_rings == NULL ) {
+			quit(1,"calloc failed for io_uring rings");
+		} /* IF */
+		for ( index = 0 ; index < num_threads ; ++index ) {
+			errcode = setup_ring(&stat_rings[index]);
+			if ( errcode != 0 ) {
+				fprintf(stderr,"io_uring is not available (%s) , using fstatat()\n",
+						strerror(errcode));
+				while ( --index >= 0 ) {
+					close(stat_rings[index].fd);
+				} /* WHILE */
+				free(stat_rings);
+				stat_rings = NULL;
+				break;
+			} /* IF */
+		} /* FOR */
+	} /* IF */
+	if ( opt_x ) {
+		root_devs = (dev_t *)calloc(num_roots,sizeof(dev_t));
+		if ( root_devs == NULL ) {
+			quit(1,"calloc failed for root devices");
+		} /* IF */
+		for ( index = 0 ; index < num_roots ; ++index ) {
+			if ( stat(root_paths[index],&filestats) < 0 ) {
+				quit(1,"stat failed for '%s'",root_paths[index]);
+			} /* IF */
+			root_devs[index] = filestats.st_dev;
+		} /* FOR */
+	} /* IF */
+	if ( opt_w ) {
+		inotify_fd = inotify_init1(IN_CLOEXEC);
+		if ( inotify_fd < 0 ) {
+			quit(1,"inotify_init1 failed");
+		} /* IF */
+		watch_root = new_watch_node(NULL,root_paths[0]);
+	} /* IF */
+	if ( opt_p ) {
+		errcode = pthread_create(&progress_thread,NULL,progress_main,NULL);
+		if ( errcode != 0 ) {
+			die(1,"pthread_create failed : %s\n",strerror(errcode));
+		} /* IF */
+	} /* IF */
+	start = now_secs();
+	collect_frontier = approx_levels > 0;
+	traverse_tree(root_paths,num_roots,watch_root,0);
+	if ( approx_levels > 0 ) {
+		sample_frontier(start);
+	} /* IF */
+	elapsed = now_secs() - start;
+	if ( opt_p ) {
+		pthread_mutex_lock(&progress_lock);
+		progress_done = 1;
+		pthread_cond_signal(&progress_cond);
+		pthread_mutex_unlock(&progress_lock);
+		pthread_join(progress_thread,NULL);
+	} /* IF */
+	if ( opt_i ) {
+		save_snapshot();
+	} /* IF */
+	if ( approx_levels > 0 ) {
+		dump_estimates(elapsed);
+	} /* IF */
+	else if ( num_roots > 1 ) {
+		for ( index = 0 ; index < num_roots ; ++index ) {
+			printf("%s\n",root_paths[index]);
+			merge_counts(index);
+			dump_counts(stdout);
+			printf("\n");
+		} /* FOR */
+		printf("All directories\n");
+		merge_counts(-1);
+		dump_counts(stdout);
+	} /* ELSE IF */
+	else {
+		merge_counts(-1);
+		dump_counts(stdout);
+	} /* ELSE */
+	if ( opt_e ) {
+		dump_extensions();
+	} /* IF */
+	if ( heavy_n > 0 ) {
+		dump_heavy(heavy_direct,"direct entries");
+		dump_heavy(heavy_recursive,"entries in their subtree");
+	} /* IF */
+	if ( opt_S ) {
+		fflush(stdout);
+		dump_stats(elapsed);
+	} /* IF */
+	if ( opt_w ) {
+		watch_tree();
+	} /* IF */
+
+	exit(total_errors() > 0 ? 1 : 0);
 } /* main */
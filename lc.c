@@ -14,6 +14,7 @@
 #include	<sys/types.h>
 #include	<sys/stat.h>
 #include	<sys/param.h>
+#include	<sys/mman.h>
 #include	<dirent.h>
 #include	<string.h>
 #include	<stdlib.h>
@@ -22,42 +23,155 @@
 #include	<libgen.h>
 #include	<strings.h>
 #include	<regex.h>
+#include	<limits.h>
+#include	<errno.h>
+#include	<fcntl.h>
+#include	<pthread.h>
+#include	<time.h>
 
-#define	LE(s1,s2)	(strcasecmp(s1,s2)<=0)
-#define	GT(s1,s2)	(strcasecmp(s1,s2)>0)
-#define	GE(s1,s2)	(strcasecmp(s1,s2)>=0)
 #define	EQ(s1,s2)	(strcmp(s1,s2)==0)
 
-typedef	struct namestag {
-	char	*name;
-	struct namestag	*next_name;
-} NAMES;
+#define	BATCH_ENTRIES	4096	/* entries read from a directory at a time */
+#define	BATCH_NAMES_SIZE	(BATCH_ENTRIES * 64)	/* size of names arena */
+#define	METADATA_CHUNK	16		/* entries claimed at a time by a metadata thread */
+#define	MAX_THREADS		256
+#define	OUTBUF_SIZE		65536	/* size of the output buffer */
+#define	MAX_SEQUENCE	64		/* maximum length of a standout sequence */
+#define	SPILL_SIZE		262144	/* size of a class spill buffer (-n) */
+#define	INIT_SPILL_SIZE	4096	/* initial size of a class spill buffer */
+#define	INIT_CLASS_ENTRIES	64		/* initial size of class arrays */
+#define	INIT_CLASS_NAMES	4096	/* initial size of class names arena */
+#define	MAX_PENDING		256		/* listings scanned ahead of the output (-R) */
+#define	CACHE_MAGIC		"LCCACHE1"
+#define	CACHE_RACY_SECS	2		/* directories changed more recently are not cached */
+
+#define	NUM_CLASSES		8		/* classes in display order */
+#define	CLASS_REGULAR	0
+#define	CLASS_DIR		1
+#define	CLASS_CHAR		2
+#define	CLASS_BLOCK		3
+#define	CLASS_PIPE		4
+#define	CLASS_SYMLINK	5
+#define	CLASS_SOCKET	6
+#define	CLASS_MISC		7
+
+#define	ENTRY_NAME(list,entry)	((list)->names + (entry)->name_offset)
+
+#define	CLASS_NAME(class_ptr,index)	\
+			((class_ptr)->names + (class_ptr)->name_offsets[index])
 
 typedef	struct fileclass {
 	char	*class_title;
+	char	*class_key;		/* short name used for records (-0) */
 	int	num_entries;
 	int	longest_name;
-	NAMES	*first_name , *last_name;
+	int	max_entries;
+	char	*names;			/* arena holding the names */
+	size_t	names_used , names_size;
+	size_t	*name_offsets;	/* offset of each name in the arena */
+	char	*exec_flags;	/* non-zero if accessible with X_OK (-x) */
+	long long	*sizes;		/* file sizes (-S only) */
+	long long	*mtimes;	/* modification times in nanoseconds (-t only) */
+	int		*order;			/* display order set by sort_class() */
+	char	*spill_buf;		/* unsorted names not yet spilled (-n) */
+	int		spill_used , spill_size;
+	FILE	*spill_fp;		/* temporary file holding spilled names */
 } FILECLASS;
 
-FILECLASS regular_class = { "Regular Files" , 0 , 0 , NULL , NULL };
-FILECLASS dir_class = { "Directories" , 0 , 0 , NULL , NULL };
-FILECLASS char_class = { "Character Special" , 0 , 0 , NULL , NULL };
-FILECLASS block_class = { "Block Special" , 0 , 0 , NULL , NULL };
-FILECLASS pipe_class = { "Pipes" , 0 , 0 , NULL , NULL };
-FILECLASS symlink_class = { "Symbolic Links" , 0 , 0 , NULL , NULL };
-FILECLASS socket_class = { "Sockets" , 0 , 0 , NULL , NULL };
-FILECLASS misc_class = { "Miscellaneous" , 0 , 0 , NULL , NULL };
+typedef	struct entry_tag {
+	size_t	name_offset;	/* offset of name in names arena */
+	unsigned char	d_type;	/* type reported by readdir() */
+	char	need_stat;		/* non-zero if lstat() is required */
+	char	is_exec;		/* non-zero if accessible with X_OK (-x) */
+	char	listed;			/* zero if only read to find subdirectories */
+	int		status;			/* 0 or errno from lstat() */
+	mode_t	mode;
+	uid_t	uid;
+	long long	size;		/* -S only */
+	long long	mtime;		/* -t only */
+} ENTRY;
+
+typedef	struct dirlist_tag {
+	int		num_entries;
+	size_t	names_used;
+	ENTRY	entries[BATCH_ENTRIES];
+	char	names[BATCH_NAMES_SIZE];	/* arena holding all the names */
+} DIRLIST;
+
+typedef	struct cache_header_tag {
+	char	magic[8];
+	long long	dev , ino , mtime_sec , mtime_nsec;
+	int		signature_length;	/* options signature follows the header */
+	int		num_subdirs;
+	int		num_entries[NUM_CLASSES];
+	int		longest_name[NUM_CLASSES];
+	long long	names_size[NUM_CLASSES];	/* bytes of names in each class */
+	long long	subdirs_size;
+} CACHE_HEADER;
+
+typedef	struct sortkey_tag {
+	long long	key;		/* size or mtime , 0 when sorting by name */
+	char	*name;
+	int		index;			/* index into the class arrays */
+} SORTKEY;
+
+typedef	struct listing_tag {
+	char	*dir_path;
+	FILECLASS	classes[NUM_CLASSES];
+	int		status;			/* 0 or errno from opendir() */
+	int		done;			/* non-zero once the directory has been scanned */
+	char	**subdirs;		/* sorted subdirectory names (-R) */
+	int		num_subdirs , max_subdirs;
+	struct listing_tag	**children;	/* listings of subdirs once queued */
+	struct listing_tag	*next_queued;
+	char	*cache_map;		/* mapped cache file holding the names (-K) */
+	size_t	cache_size;
+} LISTING;
+
+typedef	struct scan_job_tag {
+	LISTING	*first_queued , *last_queued;	/* listings waiting for a thread */
+	int		pending;		/* listings queued but not yet displayed */
+	int		finished;		/* non-zero when no more listings will be queued */
+	int		metadata_threads;	/* threads for each fetch_metadata() */
+	pthread_mutex_t	lock;
+	pthread_cond_t	work_cond;	/* signalled when a listing is queued */
+	pthread_cond_t	done_cond;	/* signalled when a listing is done */
+} SCAN_JOB;
+
+typedef	struct metadata_job_tag {
+	DIRLIST	*list;
+	int		dir_fd;
+	int		next_entry;		/* next entry not yet claimed by a thread */
+	pthread_mutex_t	lock;
+} METADATA_JOB;
+
+char	*class_titles[NUM_CLASSES] = { "Regular Files" , "Directories" ,
+			"Character Special" , "Block Special" , "Pipes" ,
+			"Symbolic Links" , "Sockets" , "Miscellaneous" };
+char	*class_keys[NUM_CLASSES] = { "regular" , "directory" , "char" ,
+			"block" , "pipe" , "symlink" , "socket" , "misc" };
 
 int	columns = 0 , opt_d = 0 , opt_f = 0 , opt_b = 0 , opt_x = 0;
 int	opt_c = 0 , opt_p = 0 , opt_a = 0 , opt_l = 0 , opt_s = 0;
 int	opt_o = 0 , opt_u = 0 , opt_A = 0 , opt_F = 0 , opt_D = 0;
-int	opt_P = 0 , opt_U = 0 , opt_v = 0;
+int	opt_P = 0 , opt_U = 0 , opt_v = 0 , opt_n = 0 , opt_R = 0;
+int	opt_t = 0 , opt_S = 0 , opt_K = 0 , opt_0 = 0 , columns_given = 0;
+int	num_threads = 1 , threads_given = 0 , anytypes = 0;
 
-char	*dir_path = NULL;
+char	outbuf[OUTBUF_SIZE];
+int		outbuf_used = 0;
+char	record_prefix[MAXPATHLEN+32];	/* "class<TAB>dir/" for records (-0) */
+int		record_prefix_len = 0 , prefix_paths = 0;
+char	standout_start[MAX_SEQUENCE] , standout_end[MAX_SEQUENCE];
+int		standout_start_len = 0 , standout_end_len = 0;
 regex_t	uppercase_regexp;
 regex_t	pattern_regexp;
+char	*pattern_string = "";
 char	*progname;
+char	cache_dir[MAXPATHLEN];
+char	cache_signature[MAXPATHLEN+256];
+unsigned int	cache_hash;
+pthread_t	main_thread;
 
 uid_t	my_uid;
 gid_t	my_gid;
@@ -65,9 +179,11 @@ gid_t	my_gid;
 extern	int	optind , optopt , opterr , tty_num_rows , tty_num_cols;
 extern	char	*optarg , *__loc1;
 
-extern	void	system_error() , standout_print() , die();
+extern	void	system_error() , die() , get_standout_sequences();
 extern	int		init_termcap();
 
+void	out_flush();
+
 /*********************************************************************
 *
 * Function  : debug_print
@@ -90,323 +206,2077 @@ void debug_print(char *format,...)
 {
 	va_list ap;
 
-	if ( opt_v ) {
-		va_start(ap,format);
-		vfprintf(stdout, format, ap);
-		fflush(stdout);
-		va_end(ap);
+	if ( opt_v ) {
+		if ( pthread_equal(pthread_self(),main_thread) ) {
+			out_flush();
+		} /* IF */
+		va_start(ap,format);
+		vfprintf(stdout, format, ap);
+		fflush(stdout);
+		va_end(ap);
+	} /* IF */
+
+	return;
+} /* end of debug_print */
+
+/*********************************************************************
+*
+* Function  : out_flush
+*
+* Purpose   : Write the contents of the output buffer to stdout.
+*
+* Inputs    : (none)
+*
+* Output    : buffered output
+*
+* Returns   : (nothing)
+*
+* Example   : out_flush();
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void out_flush()
+{
+	char	*ptr;
+	ssize_t	num_bytes;
+
+	ptr = outbuf;
+	while ( outbuf_used > 0 ) {
+		num_bytes = write(1,ptr,outbuf_used);
+		if ( num_bytes < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			} /* IF */
+			quit(1,"write failed for stdout");
+		} /* IF */
+		ptr += num_bytes;
+		outbuf_used -= num_bytes;
+	} /* WHILE */
+
+	return;
+} /* end of out_flush */
+
+/*********************************************************************
+*
+* Function  : out_write
+*
+* Purpose   : Append data to the output buffer.
+*
+* Inputs    : data - data to be written
+*             length - number of bytes
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : out_write(name,namelen);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void out_write(char *data, int length)
+{
+	int		count;
+
+	while ( length > 0 ) {
+		if ( outbuf_used == OUTBUF_SIZE ) {
+			out_flush();
+		} /* IF */
+		count = OUTBUF_SIZE - outbuf_used;
+		if ( count > length ) {
+			count = length;
+		} /* IF */
+		memcpy(outbuf + outbuf_used,data,count);
+		outbuf_used += count;
+		data += count;
+		length -= count;
+	} /* WHILE */
+
+	return;
+} /* end of out_write */
+
+/*********************************************************************
+*
+* Function  : out_spaces
+*
+* Purpose   : Append blanks to the output buffer.
+*
+* Inputs    : count - number of blanks
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : out_spaces(width - namelen);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void out_spaces(int count)
+{
+	int		length;
+
+	while ( count > 0 ) {
+		if ( outbuf_used == OUTBUF_SIZE ) {
+			out_flush();
+		} /* IF */
+		length = OUTBUF_SIZE - outbuf_used;
+		if ( length > count ) {
+			length = count;
+		} /* IF */
+		memset(outbuf + outbuf_used,' ',length);
+		outbuf_used += length;
+		count -= length;
+	} /* WHILE */
+
+	return;
+} /* end of out_spaces */
+
+/*********************************************************************
+*
+* Function  : out_name
+*
+* Purpose   : Append a name padded to the column width to the output
+*             buffer, highlighting it if it is executable (-x).
+*
+* Inputs    : name - name to be written
+*             is_exec - non-zero if name is to be highlighted
+*             width - column width
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : out_name(name,is_exec,width);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void out_name(char *name, int is_exec, int width)
+{
+	int		namelen;
+
+	namelen = strlen(name);
+	if ( is_exec ) {
+		out_write(standout_start,standout_start_len);
+		out_write(name,namelen);
+		out_write(standout_end,standout_end_len);
+	} /* IF */
+	else {
+		out_write(name,namelen);
+	} /* ELSE */
+	out_spaces(width - namelen);
+
+	return;
+} /* end of out_name */
+
+/*********************************************************************
+*
+* Function  : out_column
+*
+* Purpose   : Append a name to the current output line of a row by row
+*             column layout, starting a new line when it is full.
+*
+* Inputs    : name - name to be written
+*             is_exec - non-zero if name is to be highlighted
+*             width - column width
+*             line_width - pointer to width used on the current line
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : out_column(name,is_exec,width,&line_width);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void out_column(char *name, int is_exec, int width, int *line_width)
+{
+	if ( *line_width+width > columns ) {
+		out_write("\n",1);
+		*line_width = 0;
+	}
+	out_name(name,is_exec,width);
+	*line_width += width;
+
+	return;
+} /* end of out_column */
+
+/*********************************************************************
+*
+* Function  : out_record
+*
+* Purpose   : Append a NUL terminated "class<TAB>name" record to the
+*             output buffer (-0).
+*
+* Inputs    : name - name to be written
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : out_record(name);
+*
+* Notes     : The class (and directory) part of the record is taken
+*             from record_prefix , which is set by dump_records().
+*
+*********************************************************************/
+
+void out_record(char *name)
+{
+	out_write(record_prefix,record_prefix_len);
+	out_write(name,strlen(name) + 1);
+
+	return;
+} /* end of out_record */
+
+/*********************************************************************
+*
+* Function  : out_class_title
+*
+* Purpose   : Append the highlighted title line of a class to the
+*             output buffer.
+*
+* Inputs    : class_ptr - pointer to class structure
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : out_class_title(class_ptr);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void out_class_title(FILECLASS *class_ptr)
+{
+	char	title[256];
+	int		length;
+
+	length = snprintf(title,sizeof(title),"%s [%d]",class_ptr->class_title,
+					class_ptr->num_entries);
+	out_write("\n",1);
+	out_write(standout_start,standout_start_len);
+	out_write(title,length);
+	out_write(standout_end,standout_end_len);
+	out_write("\n",1);
+
+	return;
+} /* end of out_class_title */
+
+/*********************************************************************
+*
+* Function  : wanted_name
+*
+* Purpose   : Check a filename against the name based selection options
+*             (-a , -A , -u , -P).
+*
+* Inputs    : name - unqualified filename
+*
+* Output    : (none)
+*
+* Returns   : 1 --> name is to be listed , 0 --> name is to be skipped
+*
+* Example   : if ( wanted_name(entry->d_name) ) ...
+*
+* Notes     : This is checked while the directory is being read so that
+*             no metadata is fetched for names which will not be listed.
+*
+*********************************************************************/
+
+int wanted_name(char *name)
+{
+	regmatch_t	pmatch[2];
+
+	if ( name[0] == '.' && !(opt_a || opt_A) ) {
+		return(0);
+	}
+	if ( ( EQ(name,".") || EQ(name,"..") ) && opt_A ) {
+		return(0);
+	} /* IF */
+
+	if ( opt_u &&
+			regexec(&uppercase_regexp, name, (size_t)1, pmatch, 0) != 0 ) {
+		return(0);
+	} /* IF */
+
+	if ( opt_P &&
+			regexec(&pattern_regexp, name, (size_t)1, pmatch, 0) != 0 ) {
+		return(0);
+	} /* IF */
+
+	return(1);
+} /* end of wanted_name */
+
+/*********************************************************************
+*
+* Function  : recurse_name
+*
+* Purpose   : Check if a subdirectory is to be descended into (-R).
+*
+* Inputs    : name - unqualified name of subdirectory
+*
+* Output    : (none)
+*
+* Returns   : 1 --> descend into subdirectory , 0 --> skip it
+*
+* Example   : if ( recurse_name(name) ) ...
+*
+* Notes     : Only the -a/-A rules for hidden names apply , the type
+*             and pattern selections limit what is listed but not
+*             where the listing descends.
+*
+*********************************************************************/
+
+int recurse_name(char *name)
+{
+	if ( EQ(name,".") || EQ(name,"..") ) {
+		return(0);
+	} /* IF */
+	if ( name[0] == '.' && !(opt_a || opt_A) ) {
+		return(0);
+	} /* IF */
+
+	return(1);
+} /* end of recurse_name */
+
+/*********************************************************************
+*
+* Function  : spill_name
+*
+* Purpose   : Append a filename to the unsorted names of a class (-n).
+*
+* Inputs    : class_ptr - pointer to class structure
+*             name - name of file to be added to class structure
+*             is_exec - non-zero if file is executable (-x)
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : spill_name(&dir_class,filename,0);
+*
+* Notes     : Each name is stored as a flag character followed by the
+*             NUL terminated name. The class buffer grows up to
+*             SPILL_SIZE bytes ; when that fills up it is written to a
+*             temporary file, so the memory used does not depend on the
+*             number of names.
+*
+*********************************************************************/
+
+void spill_name(FILECLASS *class_ptr, char *name, int is_exec)
+{
+	int		namelen;
+
+	namelen = strlen(name);
+	if ( namelen > class_ptr->longest_name ) {
+		class_ptr->longest_name = namelen;
+	} /* IF */
+	if ( class_ptr->spill_used + namelen + 2 > class_ptr->spill_size &&
+				class_ptr->spill_size < SPILL_SIZE ) {
+		class_ptr->spill_size = (class_ptr->spill_size == 0) ?
+								INIT_SPILL_SIZE : class_ptr->spill_size * 2;
+		class_ptr->spill_buf = realloc(class_ptr->spill_buf,
+								class_ptr->spill_size);
+		if ( class_ptr->spill_buf == NULL ) {
+			quit(1,"realloc failed for spill buffer");
+		} /* IF */
+	} /* IF */
+	if ( class_ptr->spill_used + namelen + 2 > class_ptr->spill_size ) {
+		if ( class_ptr->spill_fp == NULL ) {
+			class_ptr->spill_fp = tmpfile();
+			if ( class_ptr->spill_fp == NULL ) {
+				quit(1,"tmpfile failed");
+			} /* IF */
+		} /* IF */
+		debug_print("spill_name() : spill %d bytes of %s\n",
+						class_ptr->spill_used,class_ptr->class_title);
+		if ( fwrite(class_ptr->spill_buf,1,class_ptr->spill_used,
+					class_ptr->spill_fp) != class_ptr->spill_used ) {
+			quit(1,"write failed for spill file");
+		} /* IF */
+		class_ptr->spill_used = 0;
+	} /* IF */
+	class_ptr->spill_buf[class_ptr->spill_used++] = is_exec ? '1' : '0';
+	memcpy(class_ptr->spill_buf + class_ptr->spill_used,name,namelen + 1);
+	class_ptr->spill_used += namelen + 1;
+	class_ptr->num_entries += 1;
+
+	return;
+} /* end of spill_name */
+
+/*********************************************************************
+*
+* Function  : grow_class
+*
+* Purpose   : Enlarge the arrays of a class structure.
+*
+* Inputs    : class_ptr - pointer to class structure
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : grow_class(class_ptr);
+*
+* Notes     : The size and time arrays are only kept for -S and -t.
+*
+*********************************************************************/
+
+void grow_class(FILECLASS *class_ptr)
+{
+	int		max_entries;
+
+	max_entries = (class_ptr->max_entries == 0) ? INIT_CLASS_ENTRIES :
+						class_ptr->max_entries * 2;
+	class_ptr->name_offsets = (size_t *)realloc(class_ptr->name_offsets,
+						max_entries * sizeof(size_t));
+	class_ptr->exec_flags = realloc(class_ptr->exec_flags,max_entries);
+	if ( class_ptr->name_offsets == NULL || class_ptr->exec_flags == NULL ) {
+		quit(1,"realloc failed for class arrays");
+	} /* IF */
+	if ( opt_S ) {
+		class_ptr->sizes = (long long *)realloc(class_ptr->sizes,
+						max_entries * sizeof(long long));
+		if ( class_ptr->sizes == NULL ) {
+			quit(1,"realloc failed for class sizes");
+		} /* IF */
+	} /* IF */
+	if ( opt_t ) {
+		class_ptr->mtimes = (long long *)realloc(class_ptr->mtimes,
+						max_entries * sizeof(long long));
+		if ( class_ptr->mtimes == NULL ) {
+			quit(1,"realloc failed for class times");
+		} /* IF */
+	} /* IF */
+	class_ptr->max_entries = max_entries;
+
+	return;
+} /* end of grow_class */
+
+/*********************************************************************
+*
+* Function  : add_to_class
+*
+* Purpose   : Add the specified unqualified filename to the specified
+*             class.
+*
+* Inputs    : class_ptr - pointer to class structure
+*             name - name of file to be added to class structure
+*             entry - pointer to directory entry for the file
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : add_to_class(&classes[CLASS_DIR],name,entry);
+*
+* Notes     : The names are appended to the class arrays and put into
+*             order by sort_class() once the directory has been read.
+*             With -n the name is appended unsorted (see spill_name).
+*
+*********************************************************************/
+
+void add_to_class(FILECLASS *class_ptr, char *name, ENTRY *entry)
+{
+	int		namelen , index;
+
+	if ( opt_F ) {
+		class_ptr->num_entries += 1;
+		return;
+	} /* IF */
+	if ( opt_n ) {
+		spill_name(class_ptr,name,entry->is_exec);
+		return;
+	} /* IF */
+
+	debug_print("add_to_class(%s)\n",name);
+	if ( class_ptr->num_entries >= class_ptr->max_entries ) {
+		grow_class(class_ptr);
+	} /* IF */
+	namelen = strlen(name);
+	if ( class_ptr->names_used + namelen + 1 > class_ptr->names_size ) {
+		if ( class_ptr->names_size == 0 ) {
+			class_ptr->names_size = INIT_CLASS_NAMES;
+		} /* IF */
+		while ( class_ptr->names_used + namelen + 1 > class_ptr->names_size ) {
+			class_ptr->names_size *= 2;
+		} /* WHILE */
+		class_ptr->names = realloc(class_ptr->names,class_ptr->names_size);
+		if ( class_ptr->names == NULL ) {
+			quit(1,"realloc failed for class names");
+		} /* IF */
+	} /* IF */
+	if ( namelen > class_ptr->longest_name ) {
+		class_ptr->longest_name = namelen;
+	}
+
+	index = class_ptr->num_entries;
+	class_ptr->name_offsets[index] = class_ptr->names_used;
+	memcpy(class_ptr->names + class_ptr->names_used,name,namelen + 1);
+	class_ptr->names_used += namelen + 1;
+	class_ptr->exec_flags[index] = entry->is_exec;
+	if ( opt_S ) {
+		class_ptr->sizes[index] = entry->size;
+	} /* IF */
+	if ( opt_t ) {
+		class_ptr->mtimes[index] = entry->mtime;
+	} /* IF */
+	class_ptr->num_entries += 1;
+
+	return;
+} /* end of add_to_class */
+
+/*********************************************************************
+*
+* Function  : compare_keys
+*
+* Purpose   : Compare two sort keys for qsort().
+*
+* Inputs    : ptr1 - pointer to first key
+*             ptr2 - pointer to second key
+*
+* Output    : (none)
+*
+* Returns   : <0 , 0 , >0 (ala strcmp)
+*
+* Example   : qsort(keys,num_entries,sizeof(SORTKEY),compare_keys);
+*
+* Notes     : Larger keys (bigger or newer files) sort first. Equal
+*             keys are ordered by name ignoring case , then by name.
+*
+*********************************************************************/
+
+int compare_keys(const void *ptr1, const void *ptr2)
+{
+	SORTKEY	*key1 , *key2;
+	int		result;
+
+	key1 = (SORTKEY *)ptr1;
+	key2 = (SORTKEY *)ptr2;
+	if ( key1->key != key2->key ) {
+		return( (key1->key > key2->key) ? -1 : 1 );
+	} /* IF */
+	result = strcasecmp(key1->name,key2->name);
+	if ( result == 0 ) {
+		result = strcmp(key1->name,key2->name);
+	} /* IF */
+
+	return(result);
+} /* end of compare_keys */
+
+/*********************************************************************
+*
+* Function  : sort_class
+*
+* Purpose   : Set the display order of the names in a class.
+*
+* Inputs    : class_ptr - pointer to class structure
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : sort_class(&listing->classes[index]);
+*
+* Notes     : The order is by name (ignoring case) , by size for -S or
+*             by modification time for -t. The keys are copied into one
+*             compact array so that the sort does not chase pointers.
+*
+*********************************************************************/
+
+void sort_class(FILECLASS *class_ptr)
+{
+	SORTKEY	*keys;
+	int		index;
+
+	if ( class_ptr->num_entries <= 0 || opt_n || opt_F ) {
+		return;
+	} /* IF */
+	keys = (SORTKEY *)malloc(class_ptr->num_entries * sizeof(SORTKEY));
+	class_ptr->order = (int *)malloc(class_ptr->num_entries * sizeof(int));
+	if ( keys == NULL || class_ptr->order == NULL ) {
+		quit(1,"malloc failed for sort keys");
+	} /* IF */
+	for ( index = 0 ; index < class_ptr->num_entries ; ++index ) {
+		keys[index].key = opt_S ? class_ptr->sizes[index] :
+							opt_t ? class_ptr->mtimes[index] : 0;
+		keys[index].name = CLASS_NAME(class_ptr,index);
+		keys[index].index = index;
+	} /* FOR */
+	qsort(keys,class_ptr->num_entries,sizeof(SORTKEY),compare_keys);
+	for ( index = 0 ; index < class_ptr->num_entries ; ++index ) {
+		class_ptr->order[index] = keys[index].index;
+	} /* FOR */
+	free(keys);
+
+	return;
+} /* end of sort_class */
+
+/*********************************************************************
+*
+* Function  : dtype_to_mode
+*
+* Purpose   : Convert a d_type value from readdir() into the matching
+*             S_IFMT file type bits.
+*
+* Inputs    : d_type - type reported by readdir()
+*
+* Output    : (none)
+*
+* Returns   : file type bits , 0 if the type is not known
+*
+* Example   : mode = dtype_to_mode(entry->d_type);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+mode_t dtype_to_mode(unsigned char d_type)
+{
+	switch ( d_type ) {
+	case DT_DIR:
+		return(S_IFDIR);
+	case DT_REG:
+		return(S_IFREG);
+	case DT_BLK:
+		return(S_IFBLK);
+	case DT_CHR:
+		return(S_IFCHR);
+	case DT_FIFO:
+		return(S_IFIFO);
+	case DT_LNK:
+		return(S_IFLNK);
+	case DT_SOCK:
+		return(S_IFSOCK);
+	} /* SWITCH */
+
+	return(0);
+} /* end of dtype_to_mode */
+
+/*********************************************************************
+*
+* Function  : add_entry
+*
+* Purpose   : Append a directory entry to a directory entries list.
+*
+* Inputs    : list - pointer to directory entries list
+*             name - unqualified filename
+*             d_type - type reported by readdir()
+*             listed - zero if entry is only needed for -R
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : add_entry(list,entry->d_name,entry->d_type,1);
+*
+* Notes     : The caller must ensure that the list has room for the
+*             entry (see read_directory).
+*
+*********************************************************************/
+
+void add_entry(DIRLIST *list, char *name, unsigned char d_type, int listed)
+{
+	ENTRY	*entry;
+	size_t	namelen;
+
+	namelen = strlen(name) + 1;
+	entry = &list->entries[list->num_entries++];
+	entry->name_offset = list->names_used;
+	memcpy(list->names + list->names_used,name,namelen);
+	list->names_used += namelen;
+	entry->d_type = d_type;
+	entry->mode = dtype_to_mode(d_type);
+	entry->listed = listed;
+	entry->need_stat = ((opt_U || opt_t || opt_S) && listed) ||
+							entry->mode == 0;
+	entry->is_exec = 0;
+	entry->status = 0;
+	entry->uid = 0;
+	entry->size = 0;
+	entry->mtime = 0;
+
+	return;
+} /* end of add_entry */
+
+/*********************************************************************
+*
+* Function  : read_directory
+*
+* Purpose   : Read the next batch of wanted entries of a directory
+*             into a directory entries list.
+*
+* Inputs    : dirptr - pointer to open directory
+*             list - pointer to directory entries list
+*
+* Output    : (none)
+*
+* Returns   : 1 --> more entries may remain , 0 --> end of directory
+*
+* Example   : more = read_directory(dirptr,&dir_list);
+*
+* Notes     : The entries are kept in directory order. The list has a
+*             fixed size so memory use does not depend on the size of
+*             the directory.
+*
+*********************************************************************/
+
+int read_directory(DIR *dirptr, DIRLIST *list)
+{
+	struct dirent	*entry;
+
+	list->num_entries = 0;
+	list->names_used = 0;
+	while ( list->num_entries < BATCH_ENTRIES &&
+				list->names_used + NAME_MAX + 1 <= BATCH_NAMES_SIZE ) {
+		entry = readdir(dirptr);
+		if ( entry == NULL ) {
+			return(0);
+		} /* IF */
+		debug_print("Process directory entry [%s]\n",entry->d_name);
+		if ( wanted_name(entry->d_name) ) {
+			add_entry(list,entry->d_name,entry->d_type,1);
+		} /* IF */
+		else if ( opt_R && (entry->d_type == DT_DIR ||
+					entry->d_type == DT_UNKNOWN) && recurse_name(entry->d_name) ) {
+			add_entry(list,entry->d_name,entry->d_type,0);
+		} /* ELSE IF */
+	} /* WHILE loop over directory entries */
+
+	return(1);
+} /* end of read_directory */
+
+/*********************************************************************
+*
+* Function  : stat_entry
+*
+* Purpose   : Fetch the metadata for one directory entry, and its
+*             executable status if -x was specified.
+*
+* Inputs    : dir_fd - file descriptor of the directory
+*             list - pointer to directory entries list
+*             entry - pointer to entry
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : stat_entry(dir_fd,list,entry);
+*
+* Notes     : Errors are recorded in the entry rather than reported
+*             here, so this may be called from any thread.
+*
+*********************************************************************/
+
+void stat_entry(int dir_fd, DIRLIST *list, ENTRY *entry)
+{
+	struct stat	filestats;
+
+	if ( entry->need_stat ) {
+		if ( fstatat(dir_fd,ENTRY_NAME(list,entry),&filestats,
+							AT_SYMLINK_NOFOLLOW) == 0 ) {
+			entry->mode = filestats.st_mode & S_IFMT;
+			entry->uid = filestats.st_uid;
+			entry->size = filestats.st_size;
+			entry->mtime = (long long)filestats.st_mtim.tv_sec * 1000000000LL +
+							filestats.st_mtim.tv_nsec;
+		} /* IF */
+		else {
+			entry->status = errno;
+			return;
+		} /* ELSE */
+	} /* IF */
+	if ( opt_x && entry->listed ) {
+		entry->is_exec = faccessat(dir_fd,ENTRY_NAME(list,entry),X_OK,0) == 0;
+	} /* IF */
+
+	return;
+} /* end of stat_entry */
+
+/*********************************************************************
+*
+* Function  : metadata_worker
+*
+* Purpose   : Thread function which fetches metadata for directory
+*             entries until the list is exhausted.
+*
+* Inputs    : arg - pointer to METADATA_JOB structure
+*
+* Output    : (none)
+*
+* Returns   : NULL
+*
+* Example   : pthread_create(&thread,NULL,metadata_worker,&job);
+*
+* Notes     : Entries are claimed in small chunks so that a slow server
+*             response only holds up one thread.
+*
+*********************************************************************/
+
+void *metadata_worker(void *arg)
+{
+	METADATA_JOB	*job;
+	ENTRY	*entry;
+	int		first , last , index;
+
+	job = (METADATA_JOB *)arg;
+	while ( 1 ) {
+		pthread_mutex_lock(&job->lock);
+		first = job->next_entry;
+		job->next_entry += METADATA_CHUNK;
+		pthread_mutex_unlock(&job->lock);
+		if ( first >= job->list->num_entries ) {
+			break;
+		} /* IF */
+		last = first + METADATA_CHUNK;
+		if ( last > job->list->num_entries ) {
+			last = job->list->num_entries;
+		} /* IF */
+		for ( index = first ; index < last ; ++index ) {
+			entry = &job->list->entries[index];
+			if ( entry->need_stat || (opt_x && entry->listed) ) {
+				stat_entry(job->dir_fd,job->list,entry);
+			} /* IF */
+		} /* FOR */
+	} /* WHILE */
+
+	return(NULL);
+} /* end of metadata_worker */
+
+/*********************************************************************
+*
+* Function  : fetch_metadata
+*
+* Purpose   : Fetch the metadata for all the directory entries which
+*             require it.
+*
+* Inputs    : dir_fd - file descriptor of the directory
+*             list - pointer to directory entries list
+*             max_threads - maximum number of threads to be used
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : fetch_metadata(dirfd(dirptr),list,max_threads);
+*
+* Notes     : If more than one thread was requested (-T) the lookups are
+*             spread across a pool of threads. Each result is stored in
+*             its own entry so the directory order is preserved.
+*
+*********************************************************************/
+
+void fetch_metadata(int dir_fd, DIRLIST *list, int max_threads)
+{
+	METADATA_JOB	job;
+	pthread_t	threads[MAX_THREADS];
+	int		index , count , thread_count , errcode;
+
+	count = 0;
+	for ( index = 0 ; index < list->num_entries ; ++index ) {
+		if ( list->entries[index].need_stat ||
+					(opt_x && list->entries[index].listed) ) {
+			count += 1;
+		} /* IF */
+	} /* FOR */
+	debug_print("fetch_metadata() : %d of %d entries need metadata\n",count,
+					list->num_entries);
+	if ( count == 0 ) {
+		return;
+	} /* IF */
+
+	job.list = list;
+	job.dir_fd = dir_fd;
+	job.next_entry = 0;
+	pthread_mutex_init(&job.lock,NULL);
+
+	thread_count = max_threads;
+	if ( thread_count > (count + METADATA_CHUNK - 1) / METADATA_CHUNK ) {
+		thread_count = (count + METADATA_CHUNK - 1) / METADATA_CHUNK;
+	} /* IF */
+	if ( thread_count <= 1 ) {
+		metadata_worker(&job);
+	} /* IF */
+	else {
+		for ( index = 0 ; index < thread_count ; ++index ) {
+			errcode = pthread_create(&threads[index],NULL,metadata_worker,&job);
+			if ( errcode != 0 ) {
+				errno = errcode;
+				quit(1,"pthread_create failed");
+			} /* IF */
+		} /* FOR */
+		for ( index = 0 ; index < thread_count ; ++index ) {
+			pthread_join(threads[index],NULL);
+		} /* FOR */
+	} /* ELSE */
+	pthread_mutex_destroy(&job.lock);
+
+	return;
+} /* end of fetch_metadata */
+
+/*********************************************************************
+*
+* Function  : add_subdir
+*
+* Purpose   : Remember the name of a subdirectory to be listed (-R).
+*
+* Inputs    : listing - pointer to listing of the directory
+*             name - unqualified name of subdirectory
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : add_subdir(listing,name);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void add_subdir(LISTING *listing, char *name)
+{
+	if ( listing->num_subdirs >= listing->max_subdirs ) {
+		listing->max_subdirs = (listing->max_subdirs == 0) ? 16 :
+									listing->max_subdirs * 2;
+		listing->subdirs = (char **)realloc(listing->subdirs,
+									listing->max_subdirs * sizeof(char *));
+		if ( listing->subdirs == NULL ) {
+			quit(1,"realloc failed for subdirectories");
+		} /* IF */
+	} /* IF */
+	listing->subdirs[listing->num_subdirs] = strdup(name);
+	if ( listing->subdirs[listing->num_subdirs] == NULL ) {
+		quit(1,"strdup failed");
+	} /* IF */
+	listing->num_subdirs += 1;
+
+	return;
+} /* end of add_subdir */
+
+/*********************************************************************
+*
+* Function  : classify_entries
+*
+* Purpose   : Add each directory entry to the class for its file type.
+*
+* Inputs    : listing - pointer to listing of the directory
+*             list - pointer to directory entries list
+*
+* Output    : error messages for entries whose lstat() failed
+*
+* Returns   : (nothing)
+*
+* Example   : classify_entries(listing,list);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void classify_entries(LISTING *listing, DIRLIST *list)
+{
+	ENTRY	*entry;
+	char	*name;
+	int		index;
+	FILECLASS	*classes;
+
+	classes = listing->classes;
+	for ( index = 0 ; index < list->num_entries ; ++index ) {
+		entry = &list->entries[index];
+		name = ENTRY_NAME(list,entry);
+		if ( entry->status != 0 ) {
+			errno = entry->status;
+			system_error("lstat failed for \"%s/%s\"",listing->dir_path,name);
+			continue;
+		} /* IF lstat failed */
+		if ( opt_R && entry->mode == S_IFDIR && recurse_name(name) ) {
+			add_subdir(listing,name);
+		} /* IF */
+		if ( ! entry->listed )
+			continue;
+		if ( opt_U && entry->uid != my_uid )
+			continue;
+		switch ( entry->mode ) {
+		case S_IFDIR:
+			if ( opt_d ) {
+				add_to_class(&classes[CLASS_DIR],name,entry);
+			}
+			break;
+		case S_IFREG:
+			if ( opt_f ) {
+				add_to_class(&classes[CLASS_REGULAR],name,entry);
+			}
+			break;
+		case S_IFBLK:
+			if ( opt_b ) {
+				add_to_class(&classes[CLASS_BLOCK],name,entry);
+			}
+			break;
+		case S_IFCHR:
+			if ( opt_c ) {
+				add_to_class(&classes[CLASS_CHAR],name,entry);
+			}
+			break;
+		case S_IFIFO:
+			if ( opt_p ) {
+				add_to_class(&classes[CLASS_PIPE],name,entry);
+			}
+			break;
+		case S_IFLNK:
+			if ( opt_l ) {
+				add_to_class(&classes[CLASS_SYMLINK],name,entry);
+			}
+			break;
+		case S_IFSOCK:
+			if ( opt_s ) {
+				add_to_class(&classes[CLASS_SOCKET],name,entry);
+			}
+			break;
+		default:
+			fprintf(stderr,"Unexpected mode %o for %s\n",
+					entry->mode,name);
+			if ( !anytypes ) {
+				add_to_class(&classes[CLASS_MISC],name,entry);
+			} /* IF */
+		} /* end of SWITCH */
+	} /* FOR loop over directory entries */
+
+	return;
+} /* end of classify_entries */
+
+/*********************************************************************
+*
+* Function  : dump_spilled_names
+*
+* Purpose   : Display the unsorted names of a class (-n).
+*
+* Inputs    : class_ptr - pointer to class structure
+*             width - column width
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : dump_spilled_names(&dir_class,width);
+*
+* Notes     : The names which were written to the spill file are
+*             displayed first, followed by those still in the buffer.
+*
+*********************************************************************/
+
+void dump_spilled_names(FILECLASS *class_ptr, int width)
+{
+	char	*record , *ptr , *end;
+	size_t	record_size;
+	int		line_width;
+
+	line_width = 0;
+	if ( class_ptr->spill_fp != NULL ) {
+		rewind(class_ptr->spill_fp);
+		record = NULL;
+		record_size = 0;
+		while ( getdelim(&record,&record_size,'\0',class_ptr->spill_fp) > 0 ) {
+			if ( opt_0 ) {
+				out_record(record + 1);
+			} /* IF */
+			else {
+				out_column(record + 1,record[0] == '1',width,&line_width);
+			} /* ELSE */
+		} /* WHILE */
+		free(record);
+		fclose(class_ptr->spill_fp);
+		class_ptr->spill_fp = NULL;
+	} /* IF */
+	ptr = class_ptr->spill_buf;
+	end = ptr + class_ptr->spill_used;
+	while ( ptr < end ) {
+		if ( opt_0 ) {
+			out_record(ptr + 1);
+		} /* IF */
+		else {
+			out_column(ptr + 1,ptr[0] == '1',width,&line_width);
+		} /* ELSE */
+		ptr += strlen(ptr + 1) + 2;
+	} /* WHILE */
+	if ( ! opt_0 ) {
+		out_write("\n",1);
+	} /* IF */
+
+	return;
+} /* end of dump_spilled_names */
+
+/*********************************************************************
+*
+* Function  : dump_class
+*
+* Purpose   : Display the contents of the specified class structure.
+*
+* Inputs    : class_ptr - pointer to class structure
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : dump_class(&dir_class);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void dump_class(FILECLASS *class_ptr)
+{
+	int		line_width , width , count , index;
+
+	debug_print("dump_class(%s) count = %d\n",class_ptr->class_title,
+					class_ptr->num_entries);
+	if ( class_ptr->num_entries <= 0 ) {
+		return;
+	}
+	line_width = 0;
+	out_class_title(class_ptr);
+	if ( opt_F ) {
+		return;
+	} /* IF */
+	width = class_ptr->longest_name + 1;
+	if ( opt_n ) {
+		dump_spilled_names(class_ptr,width);
+		return;
+	} /* IF */
+	for ( count = 0 ; count < class_ptr->num_entries ; ++count ) {
+		index = class_ptr->order[count];
+		out_column(CLASS_NAME(class_ptr,index),class_ptr->exec_flags[index],
+					width,&line_width);
+	} /* FOR */
+	out_write("\n",1);
+
+	return;
+} /* end of dump_class */
+
+/*********************************************************************
+*
+* Function  : dump_records
+*
+* Purpose   : Display the contents of a class as NUL terminated
+*             "class<TAB>name" records (-0).
+*
+* Inputs    : listing - pointer to listing of the directory
+*             class_ptr - pointer to class structure
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : dump_records(listing,&listing->classes[index]);
+*
+* Notes     : With several directories or -R the names are prefixed
+*             with their directory. With -F one "class<TAB>count"
+*             record (or "class<TAB>dir<TAB>count") is written for
+*             the class.
+*
+*********************************************************************/
+
+void dump_records(LISTING *listing, FILECLASS *class_ptr)
+{
+	int		count , length;
+
+	if ( class_ptr->num_entries <= 0 ) {
+		return;
+	}
+	if ( opt_F ) {
+		length = prefix_paths ?
+			snprintf(record_prefix,sizeof(record_prefix),"%s\t%s\t%d",
+				class_ptr->class_key,listing->dir_path,class_ptr->num_entries) :
+			snprintf(record_prefix,sizeof(record_prefix),"%s\t%d",
+				class_ptr->class_key,class_ptr->num_entries);
+		if ( length >= sizeof(record_prefix) ) {
+			length = sizeof(record_prefix) - 1;
+		} /* IF */
+		out_write(record_prefix,length + 1);
+		return;
+	} /* IF */
+	if ( prefix_paths ) {
+		length = strlen(listing->dir_path);
+		record_prefix_len = snprintf(record_prefix,sizeof(record_prefix),
+						(length > 0 && listing->dir_path[length-1] == '/') ?
+						"%s\t%s" : "%s\t%s/",class_ptr->class_key,
+						listing->dir_path);
+	} /* IF */
+	else {
+		record_prefix_len = snprintf(record_prefix,sizeof(record_prefix),
+						"%s\t",class_ptr->class_key);
+	} /* ELSE */
+	if ( record_prefix_len >= sizeof(record_prefix) ) {
+		record_prefix_len = sizeof(record_prefix) - 1;
+	} /* IF */
+	if ( opt_n ) {
+		dump_spilled_names(class_ptr,0);
+		return;
+	} /* IF */
+	for ( count = 0 ; count < class_ptr->num_entries ; ++count ) {
+		out_record(CLASS_NAME(class_ptr,class_ptr->order[count]));
+	} /* FOR */
+
+	return;
+} /* end of dump_records */
+
+/*********************************************************************
+*
+* Function  : extract_name
+*
+* Purpose   : Extract a name from the display order of a class.
+*
+* Inputs    : order - display order of names
+*             num_names - number of names in list
+*             row - row position
+*             col - column position
+*
+* Output    : (none)
+*
+* Returns   : index of located name in class arrays , -1 if past the end
+*
+* Example   : index = extract_name(order,num_entries,needed_rows,row,col);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+int extract_name(int *order, int num_names, int num_rows,int row,int col)
+{
+	int		position , index;
+
+	position = (col * num_rows) + row;
+	index = (position < num_names) ? order[position] : -1;
+
+	return(index);
+} /* end of extract_name */
+
+/*********************************************************************
+*
+* Function  : dump_class2
+*
+* Purpose   : Display the contents of the specified class structure.
+*
+* Inputs    : class_ptr - pointer to class structure
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : dump_class2(&dir_class);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void dump_class2(FILECLASS *class_ptr)
+{
+	int		line_width , width , cols_per_row , needed_rows;
+	int		row , col , num_entries , index;
+
+	num_entries = class_ptr->num_entries;
+	if ( num_entries <= 0 ) {
+		return;
+	}
+	out_class_title(class_ptr);
+	if ( opt_F ) {
+		return;
+	} /* IF */
+	line_width = 0;
+	width = class_ptr->longest_name + 1;
+
+	cols_per_row = columns / width;
+	if ( cols_per_row < 1 ) {
+		cols_per_row = 1;
+	} /* IF */
+	needed_rows = (class_ptr->num_entries + cols_per_row - 1) / cols_per_row;
+
+	for ( row = 0 ; row < needed_rows ; ++row ) {
+		for ( col = 0 ; col < cols_per_row ; ++col ) {
+			index = extract_name(class_ptr->order,num_entries,needed_rows,row,col);
+			if ( line_width+width > columns ) {
+				out_write("\n",1);
+				line_width = 0;
+			} /* IF */
+			line_width += width;
+			if ( index < 0 ) {
+				out_spaces(width);
+				continue;
+			} /* IF */
+			out_name(CLASS_NAME(class_ptr,index),class_ptr->exec_flags[index],
+						width);
+		} /* FOR over columns per row */
+	} /* FOR over rows */
+	out_write("\n",1);
+
+#ifdef OLD_STUFF
+	node = nameslist;
+	for ( ; node != NULL ; node = node->next_name ) {
+		if ( line_width+width > columns ) {
+			printf("\n");
+			line_width = 0;
+		}
+		if ( opt_x ) {
+			sprintf(path,"%s/%s",dir_path,node->name);
+			if ( access(path,X_OK) == 0 ) {
+				standout_print("%s",node->name);
+				length = width - strlen(node->name);
+				printf("%-*.*s",length,length," ");
+			} /* IF */
+			else {
+				printf("%-*.*s",width,width,node->name);
+			} /* ELSE */
+		} /* IF */
+		else {
+			printf("%-*.*s",width,width,node->name);
+		} /* ELSE */
+		line_width += width;
+	} /* FOR */
+	printf("\n");
+#endif
+
+	return;
+} /* end of dump_class2 */
+
+/*********************************************************************
+*
+* Function  : new_listing
+*
+* Purpose   : Allocate and initialize the listing of a directory.
+*
+* Inputs    : parent_path - path of parent directory , or NULL
+*             name - name of directory
+*
+* Output    : (none)
+*
+* Returns   : pointer to new listing
+*
+* Example   : listing = new_listing(parent->dir_path,parent->subdirs[index]);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+LISTING *new_listing(char *parent_path, char *name)
+{
+	LISTING	*listing;
+	int		index , length;
+
+	listing = (LISTING *)calloc(1,sizeof(LISTING));
+	if ( listing == NULL ) {
+		quit(1,"calloc failed for listing");
+	} /* IF */
+	if ( parent_path == NULL ) {
+		listing->dir_path = strdup(name);
+	} /* IF */
+	else {
+		length = strlen(parent_path);
+		listing->dir_path = malloc(length + strlen(name) + 2);
+		if ( listing->dir_path != NULL ) {
+			if ( length > 0 && parent_path[length-1] == '/' ) {
+				sprintf(listing->dir_path,"%s%s",parent_path,name);
+			} /* IF */
+			else {
+				sprintf(listing->dir_path,"%s/%s",parent_path,name);
+			} /* ELSE */
+		} /* IF */
+	} /* ELSE */
+	if ( listing->dir_path == NULL ) {
+		quit(1,"malloc failed for directory path");
+	} /* IF */
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		listing->classes[index].class_title = class_titles[index];
+		listing->classes[index].class_key = class_keys[index];
+	} /* FOR */
+
+	return(listing);
+} /* end of new_listing */
+
+/*********************************************************************
+*
+* Function  : free_listing
+*
+* Purpose   : Free a directory listing and the names it holds.
+*
+* Inputs    : listing - pointer to listing
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : free_listing(listing);
+*
+* Notes     : The listings of the subdirectories are not freed.
+*
+*********************************************************************/
+
+void free_listing(LISTING *listing)
+{
+	FILECLASS	*class_ptr;
+	int		index;
+
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		class_ptr = &listing->classes[index];
+		if ( listing->cache_map == NULL ) {
+			free(class_ptr->names);
+		} /* IF */
+		free(class_ptr->name_offsets);
+		free(class_ptr->exec_flags);
+		free(class_ptr->sizes);
+		free(class_ptr->mtimes);
+		free(class_ptr->order);
+		free(class_ptr->spill_buf);
+		if ( class_ptr->spill_fp != NULL ) {
+			fclose(class_ptr->spill_fp);
+		} /* IF */
+	} /* FOR */
+	for ( index = 0 ; index < listing->num_subdirs ; ++index ) {
+		free(listing->subdirs[index]);
+	} /* FOR */
+	free(listing->subdirs);
+	free(listing->children);
+	if ( listing->cache_map != NULL ) {
+		munmap(listing->cache_map,listing->cache_size);
+	} /* IF */
+	free(listing->dir_path);
+	free(listing);
+
+	return;
+} /* end of free_listing */
+
+/*********************************************************************
+*
+* Function  : compare_subdirs
+*
+* Purpose   : Compare two subdirectory names for qsort().
+*
+* Inputs    : ptr1 - pointer to first name pointer
+*             ptr2 - pointer to second name pointer
+*
+* Output    : (none)
+*
+* Returns   : <0 , 0 , >0 (ala strcmp)
+*
+* Example   : qsort(subdirs,num_subdirs,sizeof(char *),compare_subdirs);
+*
+* Notes     : Names are ordered as in the class listings , with a case
+*             sensitive comparison to break ties.
+*
+*********************************************************************/
+
+int compare_subdirs(const void *ptr1, const void *ptr2)
+{
+	char	*name1 , *name2;
+	int		result;
+
+	name1 = *(char **)ptr1;
+	name2 = *(char **)ptr2;
+	result = strcasecmp(name1,name2);
+	if ( result == 0 ) {
+		result = strcmp(name1,name2);
+	} /* IF */
+
+	return(result);
+} /* end of compare_subdirs */
+
+/*********************************************************************
+*
+* Function  : queue_listing
+*
+* Purpose   : Add a listing to the queue of listings to be scanned.
+*
+* Inputs    : job - pointer to SCAN_JOB structure
+*             listing - pointer to listing
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : queue_listing(&job,listing);
+*
+* Notes     : The caller must hold the job lock.
+*
+*********************************************************************/
+
+void queue_listing(SCAN_JOB *job, LISTING *listing)
+{
+	listing->next_queued = NULL;
+	if ( job->last_queued == NULL ) {
+		job->first_queued = listing;
+	} /* IF */
+	else {
+		job->last_queued->next_queued = listing;
+	} /* ELSE */
+	job->last_queued = listing;
+	job->pending += 1;
+	pthread_cond_signal(&job->work_cond);
+
+	return;
+} /* end of queue_listing */
+
+/*********************************************************************
+*
+* Function  : queue_children
+*
+* Purpose   : Create and queue the listings of the subdirectories of a
+*             scanned directory (-R).
+*
+* Inputs    : job - pointer to SCAN_JOB structure
+*             listing - pointer to listing of the parent directory
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : queue_children(&job,listing);
+*
+* Notes     : The caller must hold the job lock.
+*
+*********************************************************************/
+
+void queue_children(SCAN_JOB *job, LISTING *listing)
+{
+	int		index;
+
+	listing->children = (LISTING **)calloc(listing->num_subdirs,
+									sizeof(LISTING *));
+	if ( listing->children == NULL ) {
+		quit(1,"calloc failed for subdirectory listings");
+	} /* IF */
+	for ( index = 0 ; index < listing->num_subdirs ; ++index ) {
+		listing->children[index] = new_listing(listing->dir_path,
+									listing->subdirs[index]);
+		queue_listing(job,listing->children[index]);
+	} /* FOR */
+
+	return;
+} /* end of queue_children */
+
+/*********************************************************************
+*
+* Function  : init_cache
+*
+* Purpose   : Set up the directory and options signature used for the
+*             listings cache (-K).
+*
+* Inputs    : (none)
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : init_cache();
+*
+* Notes     : The cache directory is $LC_CACHE_DIR , or else
+*             $XDG_CACHE_HOME/lc or $HOME/.cache/lc. The signature
+*             holds every option which affects what is listed , and a
+*             hash of it is part of each cache file name so that runs
+*             with different options do not replace each other's
+*             entries.
+*
+*********************************************************************/
+
+void init_cache()
+{
+	char	*env , *ptr;
+	int		length;
+
+	if ( (env = getenv("LC_CACHE_DIR")) != NULL ) {
+		snprintf(cache_dir,sizeof(cache_dir),"%s",env);
+	} /* IF */
+	else if ( (env = getenv("XDG_CACHE_HOME")) != NULL ) {
+		snprintf(cache_dir,sizeof(cache_dir),"%s/lc",env);
+	} /* ELSE IF */
+	else if ( (env = getenv("HOME")) != NULL ) {
+		snprintf(cache_dir,sizeof(cache_dir),"%s/.cache/lc",env);
+	} /* ELSE IF */
+	else {
+		debug_print("init_cache() : no cache directory , cache disabled\n");
+		opt_K = 0;
+		return;
+	} /* ELSE */
+
+	/* create each missing component of the cache directory path */
+	for ( ptr = cache_dir + 1 ; *ptr != '\0' ; ++ptr ) {
+		if ( *ptr == '/' ) {
+			*ptr = '\0';
+			mkdir(cache_dir,0700);
+			*ptr = '/';
+		} /* IF */
+	} /* FOR */
+	if ( mkdir(cache_dir,0700) < 0 && errno != EEXIST ) {
+		system_error("mkdir failed for \"%s\"",cache_dir);
+		opt_K = 0;
+		return;
+	} /* IF */
+
+	length = snprintf(cache_signature,sizeof(cache_signature),
+				"a%d A%d u%d F%d R%d %d%d%d%d%d%d%d%d P=%s",
+				opt_a,opt_A,opt_u,opt_F,opt_R,opt_f,opt_d,opt_c,opt_b,opt_p,
+				opt_l,opt_s,anytypes,pattern_string);
+	cache_hash = 2166136261U;	/* FNV-1a */
+	for ( ptr = cache_signature ; ptr < cache_signature + length ; ++ptr ) {
+		cache_hash = (cache_hash ^ (unsigned char)*ptr) * 16777619U;
+	} /* FOR */
+	debug_print("init_cache() : dir = %s , signature = [%s]\n",cache_dir,
+					cache_signature);
+
+	return;
+} /* end of init_cache */
+
+/*********************************************************************
+*
+* Function  : cache_file_name
+*
+* Purpose   : Build the name of the cache file for a directory.
+*
+* Inputs    : path - buffer to receive the name
+*             size - size of buffer
+*             dirstats - status of the directory
+*
+* Output    : (none)
+*
+* Returns   : 1 --> name was built , 0 --> name did not fit in buffer
+*
+* Example   : if ( cache_file_name(path,sizeof(path),&dirstats) ) ...
+*
+* Notes     : A truncated name could belong to another directory , so
+*             the caller must not use it.
+*
+*********************************************************************/
+
+int cache_file_name(char *path, int size, struct stat *dirstats)
+{
+	int		length;
+
+	length = snprintf(path,size,"%s/%llx-%llx-%08x",cache_dir,
+				(unsigned long long)dirstats->st_dev,
+				(unsigned long long)dirstats->st_ino,cache_hash);
+
+	return(length >= 0 && length < size);
+} /* end of cache_file_name */
+
+/*********************************************************************
+*
+* Function  : load_cache
+*
+* Purpose   : Fill in a directory listing from its cache file (-K).
+*
+* Inputs    : listing - pointer to listing of the directory
+*             dirstats - status of the directory
+*
+* Output    : (none)
+*
+* Returns   : 1 --> listing was loaded , 0 --> no valid cache entry
+*
+* Example   : if ( load_cache(listing,&dirstats) ) ...
+*
+* Notes     : The cache file is mapped into memory and the names are
+*             used where they are ; the entry is only valid if the
+*             device , inode , modification time and options signature
+*             all match. A damaged cache file is ignored like a stale
+*             one , so the directory is read again and the file rewritten.
+*
+*********************************************************************/
+
+int load_cache(LISTING *listing, struct stat *dirstats)
+{
+	char	path[MAXPATHLEN] , *map , *ptr , *end , *area;
+	int		fd , index , count , corrupt;
+	struct stat	filestats;
+	CACHE_HEADER	*header;
+	FILECLASS	*class_ptr;
+	long long	total;
+
+	if ( ! cache_file_name(path,sizeof(path),dirstats) ) {
+		debug_print("load_cache() : cache file name too long for %s\n",listing->dir_path);
+		return(0);
+	} /* IF */
+	fd = open(path,O_RDONLY);
+	if ( fd < 0 ) {
+		return(0);
+	} /* IF */
+	if ( fstat(fd,&filestats) < 0 || filestats.st_size < sizeof(CACHE_HEADER) ) {
+		close(fd);
+		return(0);
+	} /* IF */
+	map = mmap(NULL,filestats.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if ( map == MAP_FAILED ) {
+		return(0);
+	} /* IF */
+
+	header = (CACHE_HEADER *)map;
+	total = sizeof(CACHE_HEADER) + header->signature_length +
+				header->subdirs_size;
+	corrupt = header->signature_length < 0 || header->subdirs_size < 0 ||
+				header->num_subdirs < 0;
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		total += header->names_size[index];
+		if ( header->names_size[index] < 0 || header->num_entries[index] < 0 ) {
+			corrupt = 1;
+		} /* IF */
+	} /* FOR */
+	if ( corrupt || memcmp(header->magic,CACHE_MAGIC,sizeof(header->magic)) != 0 ||
+			header->dev != dirstats->st_dev ||
+			header->ino != dirstats->st_ino ||
+			header->mtime_sec != dirstats->st_mtim.tv_sec ||
+			header->mtime_nsec != dirstats->st_mtim.tv_nsec ||
+			header->signature_length != strlen(cache_signature) ||
+			total != filestats.st_size ||
+			memcmp(map + sizeof(CACHE_HEADER),cache_signature,
+					header->signature_length) != 0 ) {
+		debug_print("load_cache() : stale cache entry for %s\n",
+						listing->dir_path);
+		munmap(map,filestats.st_size);
+		return(0);
 	} /* IF */
 
-	return;
-} /* end of debug_print */
+	area = map + sizeof(CACHE_HEADER) + header->signature_length;
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		class_ptr = &listing->classes[index];
+		ptr = area;
+		class_ptr->num_entries = header->num_entries[index];
+		class_ptr->longest_name = header->longest_name[index];
+		if ( class_ptr->num_entries > 0 && header->names_size[index] > 0 ) {
+			class_ptr->names = ptr;
+			class_ptr->name_offsets = (size_t *)malloc(class_ptr->num_entries *
+											sizeof(size_t));
+			class_ptr->order = (int *)malloc(class_ptr->num_entries *
+											sizeof(int));
+			class_ptr->exec_flags = calloc(class_ptr->num_entries,1);
+			if ( class_ptr->name_offsets == NULL || class_ptr->order == NULL ||
+						class_ptr->exec_flags == NULL ) {
+				quit(1,"malloc failed for cached class arrays");
+			} /* IF */
+			end = ptr + header->names_size[index];
+			for ( count = 0 ; count < class_ptr->num_entries && ptr < end ; ++count ) {
+				class_ptr->name_offsets[count] = ptr - class_ptr->names;
+				class_ptr->order[count] = count;
+				ptr += strnlen(ptr,end - ptr) + 1;
+			} /* FOR */
+			if ( count < class_ptr->num_entries ) {
+				corrupt = 1;
+				break;
+			} /* IF */
+		} /* IF */
+		area += header->names_size[index];
+	} /* FOR */
+	if ( corrupt ) {
+		debug_print("load_cache() : corrupt cache file %s\n",path);
+		for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+			class_ptr = &listing->classes[index];
+			free(class_ptr->name_offsets);
+			free(class_ptr->order);
+			free(class_ptr->exec_flags);
+			class_ptr->name_offsets = NULL;
+			class_ptr->order = NULL;
+			class_ptr->exec_flags = NULL;
+			class_ptr->names = NULL;
+			class_ptr->num_entries = 0;
+			class_ptr->longest_name = 0;
+		} /* FOR */
+		munmap(map,filestats.st_size);
+		return(0);
+	} /* IF the names do not match the counts */
+	ptr = area;
+	end = ptr + header->subdirs_size;
+	for ( count = 0 ; count < header->num_subdirs && ptr < end ; ++count ) {
+		add_subdir(listing,ptr);
+		ptr += strnlen(ptr,end - ptr) + 1;
+	} /* FOR */
+	listing->cache_map = map;
+	listing->cache_size = filestats.st_size;
+	debug_print("load_cache() : loaded %s from %s\n",listing->dir_path,path);
+
+	return(1);
+} /* end of load_cache */
 
 /*********************************************************************
 *
-* Function  : add_to_class
+* Function  : save_cache
 *
-* Purpose   : Add the specified unqualified filename to the specified
-*             class.
+* Purpose   : Write a scanned directory listing to its cache file (-K).
 *
-* Inputs    : class_ptr - pointer to class structure
-*             name - name of file to be added to class structure
+* Inputs    : listing - pointer to listing of the directory
+*             dirstats - status of the directory before it was read
 *
 * Output    : (none)
 *
 * Returns   : (nothing)
 *
-* Example   : add_to_class(&dir_class,filename);
+* Example   : save_cache(listing,&dirstats);
 *
-* Notes     : (none)
+* Notes     : Nothing is saved if the directory was modified while it
+*             was read , or so recently that a further change might not
+*             alter its modification time. The file is written under a
+*             temporary name and renamed so readers never see a partial
+*             entry. Failures only disable the cache for this directory.
 *
 *********************************************************************/
 
-void add_to_class(FILECLASS *class_ptr, char *name)
+void save_cache(LISTING *listing, struct stat *dirstats)
 {
-	NAMES	*node , *curr_node , *prev_node;
-	int	namelen;
-	regmatch_t	pmatch[2];
+	char	path[MAXPATHLEN] , temp_path[MAXPATHLEN] , *name;
+	int		fd , index , count , ok , length;
+	struct stat	newstats;
+	CACHE_HEADER	header;
+	FILECLASS	*class_ptr;
+	FILE	*fp;
 
-	if ( name[0] == '.' && !(opt_a || opt_A) ) {
+	if ( time(NULL) - dirstats->st_mtim.tv_sec < CACHE_RACY_SECS ) {
+		debug_print("save_cache() : %s changed too recently\n",listing->dir_path);
 		return;
-	}
-	if ( ( EQ(name,".") || EQ(name,"..") ) && opt_A ) {
+	} /* IF */
+	if ( stat(listing->dir_path,&newstats) < 0 ||
+			newstats.st_mtim.tv_sec != dirstats->st_mtim.tv_sec ||
+			newstats.st_mtim.tv_nsec != dirstats->st_mtim.tv_nsec ) {
+		debug_print("save_cache() : %s changed while read\n",listing->dir_path);
 		return;
 	} /* IF */
 
-	if ( opt_u &&
-			regexec(&uppercase_regexp, name, (size_t)1, pmatch, 0) != 0 ) {
+	memset(&header,0,sizeof(header));
+	memcpy(header.magic,CACHE_MAGIC,sizeof(header.magic));
+	header.dev = dirstats->st_dev;
+	header.ino = dirstats->st_ino;
+	header.mtime_sec = dirstats->st_mtim.tv_sec;
+	header.mtime_nsec = dirstats->st_mtim.tv_nsec;
+	header.signature_length = strlen(cache_signature);
+	header.num_subdirs = listing->num_subdirs;
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		class_ptr = &listing->classes[index];
+		header.num_entries[index] = class_ptr->num_entries;
+		header.longest_name[index] = class_ptr->longest_name;
+		header.names_size[index] = class_ptr->names_used;
+	} /* FOR */
+	for ( index = 0 ; index < listing->num_subdirs ; ++index ) {
+		header.subdirs_size += strlen(listing->subdirs[index]) + 1;
+	} /* FOR */
+
+	if ( ! cache_file_name(path,sizeof(path),dirstats) ||
+			(length = snprintf(temp_path,sizeof(temp_path),"%s.XXXXXX",path)) < 0 ||
+			length >= sizeof(temp_path) ) {
+		debug_print("save_cache() : cache file name too long for %s\n",listing->dir_path);
 		return;
 	} /* IF */
-
-	if ( opt_P &&
-			regexec(&pattern_regexp, name, (size_t)1, pmatch, 0) != 0 ) {
+	fd = mkstemp(temp_path);
+	if ( fd < 0 ) {
+		debug_print("save_cache() : mkstemp failed for %s\n",temp_path);
 		return;
 	} /* IF */
-
-	if ( opt_F ) {
-		class_ptr->num_entries += 1;
+	fp = fdopen(fd,"w");
+	if ( fp == NULL ) {
+		close(fd);
+		unlink(temp_path);
 		return;
 	} /* IF */
-
-	debug_print("add_to_class(%s)\n",name);
-	node = (NAMES *)malloc(sizeof(NAMES));
-	if ( node == NULL ) {
-		quit(1,"malloc for NAMES failed");
-	}
-	node->name = strdup(name);
-	if ( node->name == NULL ) {
-		quit(1,"malloc failed for filename");
-	}
-	namelen = strlen(node->name);
-	if ( namelen > class_ptr->longest_name ) {
-		class_ptr->longest_name = namelen;
-	}
-	node->next_name = NULL;
-	if ( class_ptr->num_entries == 0 ) {
-		class_ptr->first_name = class_ptr->last_name = node;
-	}
+	fwrite(&header,sizeof(header),1,fp);
+	fwrite(cache_signature,1,header.signature_length,fp);
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		class_ptr = &listing->classes[index];
+		if ( class_ptr->names_used == 0 ) {
+			continue;
+		} /* IF */
+		for ( count = 0 ; count < class_ptr->num_entries ; ++count ) {
+			name = CLASS_NAME(class_ptr,class_ptr->order[count]);
+			fwrite(name,1,strlen(name) + 1,fp);
+		} /* FOR */
+	} /* FOR */
+	for ( index = 0 ; index < listing->num_subdirs ; ++index ) {
+		fwrite(listing->subdirs[index],1,strlen(listing->subdirs[index]) + 1,fp);
+	} /* FOR */
+	ok = ! ferror(fp);
+	if ( fclose(fp) != 0 ) {
+		ok = 0;
+	} /* IF */
+	if ( ! ok || rename(temp_path,path) < 0 ) {
+		debug_print("save_cache() : write failed for %s\n",temp_path);
+		unlink(temp_path);
+	} /* IF */
 	else {
-		if ( LE(name,class_ptr->first_name->name) ) {
-			node->next_name = class_ptr->first_name;
-			class_ptr->first_name = node;
-		}
-		else {
-			if ( GE(name,class_ptr->last_name->name) ) {
-				class_ptr->last_name->next_name = node;
-				class_ptr->last_name = node;
-			}
-			else {
-				prev_node = NULL;
-				curr_node = class_ptr->first_name;
-				while ( GT(name,curr_node->name) ) {
-					prev_node = curr_node;
-					curr_node = curr_node->next_name;
-				}
-				node->next_name = curr_node;
-				prev_node->next_name = node;
-			}
-		}
-	}
-	class_ptr->num_entries += 1;
+		debug_print("save_cache() : saved %s in %s\n",listing->dir_path,path);
+	} /* ELSE */
 
 	return;
-} /* end of add_to_class */
+} /* end of save_cache */
 
 /*********************************************************************
 *
-* Function  : dump_class
+* Function  : scan_directory
 *
-* Purpose   : Display the contents of the specified class structure.
+* Purpose   : Read and classify all the entries of a directory.
 *
-* Inputs    : class_ptr - pointer to class structure
+* Inputs    : listing - pointer to listing of the directory
+*             list - pointer to directory entries list to be used
+*             metadata_threads - maximum threads for fetching metadata
 *
-* Output    : (none)
+* Output    : error messages for entries whose lstat() failed
 *
 * Returns   : (nothing)
 *
-* Example   : dump_class(&dir_class);
+* Example   : scan_directory(listing,list,num_threads);
 *
-* Notes     : (none)
+* Notes     : If the directory can not be opened the error number is
+*             saved in the listing and reported when it is displayed.
+*             The classes are sorted here so that with several
+*             directories the sorting is also done in parallel. With
+*             -K a valid cache entry replaces the whole scan.
 *
 *********************************************************************/
 
-void dump_class(FILECLASS *class_ptr)
+void scan_directory(LISTING *listing, DIRLIST *list, int metadata_threads)
 {
-	NAMES	*node;
-	int		line_width , width , length;
-	char	path[MAXPATHLEN];
+	DIR		*dirptr;
+	int		more , index , use_cache;
+	struct stat	dirstats;
 
-	debug_print("dump_class(%s) count = %d\n",class_ptr->class_title,
-					class_ptr->num_entries);
-	if ( class_ptr->num_entries <= 0 ) {
-		return;
-	}
-	line_width = 0;
-	printf("\n");
-	debug_print("dump_class() : call standout_print()\n");
-	standout_print("%s [%d]",class_ptr->class_title,
-				class_ptr->num_entries);
-	printf("\n");
-	fflush(stdout);
-	debug_print("dump_class() : after standout_print()\n");
-	if ( opt_F ) {
+	debug_print("Process directory [%s]\n",listing->dir_path);
+	use_cache = opt_K && stat(listing->dir_path,&dirstats) == 0;
+	if ( use_cache && load_cache(listing,&dirstats) ) {
 		return;
 	} /* IF */
-	width = class_ptr->longest_name + 1;
-	node = class_ptr->first_name;
-	for ( ; node != NULL ; node = node->next_name ) {
-		if ( line_width+width > columns ) {
-			printf("\n");
-			line_width = 0;
-		}
-		if ( opt_x ) {
-			sprintf(path,"%s/%s",dir_path,node->name);
-			if ( access(path,X_OK) == 0 ) {
-				standout_print("%s",node->name);
-				length = width - strlen(node->name);
-				printf("%-*.*s",length,length," ");
-			} /* IF */
-			else {
-				printf("%-*.*s",width,width,node->name);
-			} /* ELSE */
-		} /* IF */
-		else {
-			printf("%-*.*s",width,width,node->name);
-		} /* ELSE */
-		line_width += width;
+	dirptr = opendir(listing->dir_path);
+	if ( dirptr == NULL ) {
+		listing->status = errno;
+		return;
+	}
+
+	do {
+		more = read_directory(dirptr,list);
+		fetch_metadata(dirfd(dirptr),list,metadata_threads);
+		classify_entries(listing,list);
+	} while ( more );
+	debug_print("close directory\n");
+	closedir(dirptr);
+	debug_print("directory is now closed\n");
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		sort_class(&listing->classes[index]);
 	} /* FOR */
-	printf("\n");
+	if ( listing->num_subdirs > 1 ) {
+		qsort(listing->subdirs,listing->num_subdirs,sizeof(char *),
+				compare_subdirs);
+	} /* IF */
+	if ( use_cache ) {
+		save_cache(listing,&dirstats);
+	} /* IF */
 
 	return;
-} /* end of dump_class */
+} /* end of scan_directory */
 
 /*********************************************************************
 *
-* Function  : extract_name
+* Function  : scan_worker
 *
-* Purpose   : Extract a name from the list of names.
+* Purpose   : Thread function which scans queued directories until
+*             the job is finished.
 *
-* Inputs    : names - list of names
-*             num_names - number of names in list
-*             row - row position
-*             col - column position
+* Inputs    : arg - pointer to SCAN_JOB structure
 *
 * Output    : (none)
 *
-* Returns   : pointer to located name
+* Returns   : NULL
 *
-* Example   : name = extract_name(names,num_entries,needed_rows,row,col);
+* Example   : pthread_create(&thread,NULL,scan_worker,&job);
 *
-* Notes     : (none)
+* Notes     : With -R the subdirectories of a scanned directory are
+*             queued straight away , unless MAX_PENDING listings are
+*             already waiting to be displayed ; in that case they are
+*             queued by main() when it reaches the parent directory.
 *
 *********************************************************************/
 
-char *extract_name(char **names, int num_names, int num_rows,int row,int col)
+void *scan_worker(void *arg)
 {
-	int		position , count;
-	char	*name;
+	SCAN_JOB	*job;
+	DIRLIST	*list;
+	LISTING	*listing;
 
-	position = (col * num_rows) + row;
-	name = (position < num_names) ? names[position] : NULL;
+	job = (SCAN_JOB *)arg;
+	list = (DIRLIST *)malloc(sizeof(DIRLIST));
+	if ( list == NULL ) {
+		quit(1,"malloc failed for directory entries list");
+	} /* IF */
+	while ( 1 ) {
+		pthread_mutex_lock(&job->lock);
+		while ( job->first_queued == NULL && ! job->finished ) {
+			pthread_cond_wait(&job->work_cond,&job->lock);
+		} /* WHILE */
+		listing = job->first_queued;
+		if ( listing == NULL ) {
+			pthread_mutex_unlock(&job->lock);
+			break;
+		} /* IF */
+		job->first_queued = listing->next_queued;
+		if ( job->first_queued == NULL ) {
+			job->last_queued = NULL;
+		} /* IF */
+		pthread_mutex_unlock(&job->lock);
 
-	return(name);
-} /* end of extract_name */
+		scan_directory(listing,list,job->metadata_threads);
+
+		pthread_mutex_lock(&job->lock);
+		if ( listing->num_subdirs > 0 &&
+					job->pending + listing->num_subdirs <= MAX_PENDING ) {
+			queue_children(job,listing);
+		} /* IF */
+		listing->done = 1;
+		pthread_cond_broadcast(&job->done_cond);
+		pthread_mutex_unlock(&job->lock);
+	} /* WHILE */
+	free(list);
+
+	return(NULL);
+} /* end of scan_worker */
 
 /*********************************************************************
 *
-* Function  : dump_class2
+* Function  : dump_listing
 *
-* Purpose   : Display the contents of the specified class structure.
+* Purpose   : Display the classes of a directory listing.
 *
-* Inputs    : class_ptr - pointer to class structure
+* Inputs    : listing - pointer to listing of the directory
 *
 * Output    : (none)
 *
-* Returns   : (nothing)
+* Returns   : 0 --> success , 1 --> directory could not be opened
 *
-* Example   : dump_class2(&dir_class);
+* Example   : errors += dump_listing(listing);
 *
 * Notes     : (none)
 *
 *********************************************************************/
 
-void dump_class2(FILECLASS *class_ptr)
+int dump_listing(LISTING *listing)
 {
-	NAMES	*node , *nameslist;
-	int		line_width , width , length , cols_per_row , needed_rows;
-	int		row , col , num_entries , count;
-	char	path[MAXPATHLEN] , *name , **names;
+	int		index;
 
-	num_entries = class_ptr->num_entries;
-	if ( num_entries <= 0 ) {
-		return;
-	}
-	printf("\n");
-	standout_print("%s [%d]",class_ptr->class_title,num_entries);
-	printf("\n");
-	fflush(stdout);
-	if ( opt_F ) {
-		return;
+	if ( listing->status != 0 ) {
+		out_flush();
+		errno = listing->status;
+		system_error("opendir failed for \"%s\"",listing->dir_path);
+		return(1);
 	} /* IF */
-	nameslist = class_ptr->first_name;
-	names = (char **)calloc(num_entries,sizeof(char *));
-	if ( names == NULL ) {
-		quit(1,"calloc failed");
-	} /* IF */
-	node = nameslist;
-	for ( count = 0 ; count < num_entries ; ++count ) {
-		names[count] = strdup(node->name);
-		if ( names[count] == NULL ) {
-			quit(1,"malloc failed");
-		} /* IF */
-		node = node->next_name;
-	} /* FOR */
-
-	line_width = 0;
-	width = class_ptr->longest_name + 1;
-
-	cols_per_row = columns / width;
-	needed_rows = (class_ptr->num_entries + cols_per_row - 1) / cols_per_row;
-
-	for ( row = 0 ; row < needed_rows ; ++row ) {
-		for ( col = 0 ; col < cols_per_row ; ++col ) {
-			name = extract_name(names,num_entries,needed_rows,row,col);
-			if ( line_width+width > columns ) {
-				printf("\n");
-				line_width = 0;
-			} /* IF */
-			line_width += width;
-			if ( name == NULL ) {
-				printf("%-*.*s",width,width," ");
-				continue;
-			} /* IF */
-			if ( opt_x ) {
-				sprintf(path,"%s/%s",dir_path,name);
-				if ( access(path,X_OK) == 0 ) {
-					standout_print("%s",name);
-					length = width - strlen(name);
-					printf("%-*.*s",length,length," ");
-				} /* IF */
-				else {
-					printf("%-*.*s",width,width,name);
-				} /* ELSE */
-			} /* IF */
-			else {
-				printf("%-*.*s",width,width,name);
-			} /* ELSE */
-		} /* FOR over columns per row */
-	} /* FOR over rows */
-	printf("\n");
-	free(names);
-
-#ifdef OLD_STUFF
-	node = nameslist;
-	for ( ; node != NULL ; node = node->next_name ) {
-		if ( line_width+width > columns ) {
-			printf("\n");
-			line_width = 0;
-		}
-		if ( opt_x ) {
-			sprintf(path,"%s/%s",dir_path,node->name);
-			if ( access(path,X_OK) == 0 ) {
-				standout_print("%s",node->name);
-				length = width - strlen(node->name);
-				printf("%-*.*s",length,length," ");
-			} /* IF */
-			else {
-				printf("%-*.*s",width,width,node->name);
-			} /* ELSE */
+	for ( index = 0 ; index < NUM_CLASSES ; ++index ) {
+		if ( opt_0 ) {
+			dump_records(listing,&listing->classes[index]);
 		} /* IF */
+		else if ( opt_o ) {
+			dump_class2(&listing->classes[index]);
+		} /* ELSE IF */
 		else {
-			printf("%-*.*s",width,width,node->name);
+			dump_class(&listing->classes[index]);
 		} /* ELSE */
-		line_width += width;
 	} /* FOR */
-	printf("\n");
-#endif
 
-	return;
-} /* end of dump_class2 */
+	return(0);
+} /* end of dump_listing */
 
 /*********************************************************************
 *
@@ -428,7 +2298,7 @@ void dump_class2(FILECLASS *class_ptr)
 
 void usage()
 {
-	fprintf(stderr,"Usage : %s [-oadfbcpls] [-C num_columns] [dir_path]\n",progname);
+	fprintf(stderr,"Usage : %s [-onRtSK0adfbcpls] [-C num_columns] [-T num_threads] [dir_path ...]\n",progname);
 
 	return;
 } /* end of usage */
@@ -454,31 +2324,56 @@ void usage()
 
 int main(int argc,char *argv[])
 {
-	DIR	*dirptr;
-	char	filepath[MAXPATHLEN] , *string;
-	struct dirent	*entry;
-	struct stat	filestats;
-	mode_t	filemode;
-	int	opt , errflag , anytypes;
-	int		errcode;
+	char	*string , **dir_args , *default_dirs[1] = { "." };
+	int	opt , errflag;
+	int		errcode , num_dirs , num_scanners , index , errors , count;
+	int		stack_size , max_stack;
 	char	errmsg[256];
+	LISTING	*listing , **stack;
+	DIRLIST	*list;
+	SCAN_JOB	job;
+	pthread_t	threads[MAX_THREADS];
 
 	progname = argv[0];
-	init_termcap(stderr);
-	anytypes = 0;
-	if ( getenv("COLUMNS") != NULL ) {
-		columns = atoi(getenv("COLUMNS"));
-	} /* IF */
-	else {
-		columns = tty_num_cols;
-	} /* ELSE */
+	main_thread = pthread_self();
 
 	errflag = 0;
-	while ( (opt = getopt(argc,argv,":UFoaAdDfbcplsxuDC:P:v")) != -1 ) {
+	while ( (opt = getopt(argc,argv,":UFoaAdDfbcplsxuDnRtSK0C:P:T:v")) != -1 ) {
 		switch (opt) {
 		case 'o':
+			if ( opt_n ) {
+				fprintf(stderr,"-o and -n are mutually exclusive\n");
+				errflag += 1;
+			} /* IF */
 			opt_o = 1;
 			break;
+		case 'R':
+			opt_R = 1;
+			break;
+		case 'K':
+			opt_K = 1;
+			break;
+		case 't':
+			if ( opt_S ) {
+				fprintf(stderr,"-t and -S are mutually exclusive\n");
+				errflag += 1;
+			} /* IF */
+			opt_t = 1;
+			break;
+		case 'S':
+			if ( opt_t ) {
+				fprintf(stderr,"-S and -t are mutually exclusive\n");
+				errflag += 1;
+			} /* IF */
+			opt_S = 1;
+			break;
+		case 'n':
+			if ( opt_o ) {
+				fprintf(stderr,"-n and -o are mutually exclusive\n");
+				errflag += 1;
+			} /* IF */
+			opt_n = 1;
+			break;
 		case 'v':
 			opt_v = 1;
 			break;
@@ -487,9 +2382,23 @@ int main(int argc,char *argv[])
 			break;
 		case 'C':
 			columns = atoi(optarg);
+			columns_given = 1;
+			break;
+		case '0':
+			opt_0 = 1;
+			break;
+		case 'T':
+			num_threads = atoi(optarg);
+			threads_given = 1;
+			if ( num_threads < 1 || num_threads > MAX_THREADS ) {
+				fprintf(stderr,"Number of threads must be between 1 and %d\n",
+						MAX_THREADS);
+				errflag += 1;
+			} /* IF */
 			break;
 		case 'P':
 			opt_P = 1;
+			pattern_string = optarg;
 			errcode = regcomp(&pattern_regexp, optarg, REG_EXTENDED);
 			if ( errcode != 0 ) {
 				regerror(errcode,&pattern_regexp,errmsg,sizeof(errmsg));
@@ -573,10 +2482,35 @@ int main(int argc,char *argv[])
 			errflag += 1;
 		} /* SWITCH */
 	} /* WHILE loop over options */
+	if ( opt_n && (opt_t || opt_S) ) {
+		fprintf(stderr,"-n can not be used with -t or -S\n");
+		errflag += 1;
+	} /* IF */
+	if ( opt_K && (opt_x || opt_U || opt_t || opt_S || opt_n) ) {
+		/* these depend on the files themselves , not the directory */
+		fprintf(stderr,"-K can not be used with -x , -U , -t , -S or -n\n");
+		errflag += 1;
+	} /* IF */
 	if ( errflag ) {
 		usage();
 		die(1,"\n%s aborted.\n",argv[0]);
 	}
+	if ( ! opt_0 ) {
+		/* the terminal is only needed for the column layout */
+		init_termcap(stderr);
+		get_standout_sequences(standout_start,standout_end,MAX_SEQUENCE);
+		standout_start_len = strlen(standout_start);
+		standout_end_len = strlen(standout_end);
+		if ( columns_given ) {
+			;
+		} /* IF */
+		else if ( getenv("COLUMNS") != NULL ) {
+			columns = atoi(getenv("COLUMNS"));
+		} /* ELSE IF */
+		else {
+			columns = tty_num_cols;
+		} /* ELSE */
+	} /* IF */
 	if ( columns < 40 ) {
 		columns = 40;
 	} /* IF */
@@ -587,93 +2521,112 @@ int main(int argc,char *argv[])
 
 	my_uid = getuid();
 	my_gid = getgid();
+	if ( opt_K ) {
+		init_cache();
+	} /* IF */
 
-	dir_path = (optind < argc) ? argv[optind] : ".";
-	debug_print("Process directory [%s]\n",dir_path);
-	dirptr = opendir(dir_path);
-	if ( dirptr == NULL ) {
-		quit(1,"opendir failed for \"%s\"",dir_path);
-	}
+	num_dirs = argc - optind;
+	dir_args = &argv[optind];
+	if ( num_dirs == 0 ) {
+		num_dirs = 1;
+		dir_args = default_dirs;
+	} /* IF */
+	prefix_paths = num_dirs > 1 || opt_R;
+	/* several directories are scanned concurrently , by one thread per */
+	/* CPU unless -T was specified , and any -T threads left over are */
+	/* used to fetch the metadata within each directory */
+	num_scanners = threads_given ? num_threads : sysconf(_SC_NPROCESSORS_ONLN);
+	if ( num_scanners > MAX_THREADS ) {
+		num_scanners = MAX_THREADS;
+	} /* IF */
+	if ( num_scanners < 1 || (num_dirs == 1 && ! opt_R) ) {
+		num_scanners = 1;
+	} /* IF */
+	memset(&job,0,sizeof(job));
+	job.metadata_threads = threads_given ? num_threads / num_scanners : 1;
+	if ( job.metadata_threads < 1 ) {
+		job.metadata_threads = 1;
+	} /* IF */
+	pthread_mutex_init(&job.lock,NULL);
+	pthread_cond_init(&job.work_cond,NULL);
+	pthread_cond_init(&job.done_cond,NULL);
 
-	entry = readdir(dirptr);
-	for ( ; entry != NULL ; entry = readdir(dirptr) ) {
-		debug_print("Process directory entry [%s]\n",entry->d_name);
-		sprintf(filepath,"%s/%s",dir_path,entry->d_name);
-		if ( lstat(filepath,&filestats) == 0 ) {
-			if ( opt_U && filestats.st_uid != my_uid )
-				continue;
-			filemode = filestats.st_mode & S_IFMT;
-			switch ( filemode ) {
-			case S_IFDIR:
-				if ( opt_d ) {
-					add_to_class(&dir_class,entry->d_name);
-				}
-				break;
-			case S_IFREG:
-				if ( opt_f ) {
-					add_to_class(&regular_class,entry->d_name);
-				}
-				break;
-			case S_IFBLK:
-				if ( opt_b ) {
-					add_to_class(&block_class,entry->d_name);
-				}
-				break;
-			case S_IFCHR:
-				if ( opt_c ) {
-					add_to_class(&char_class,entry->d_name);
-				}
-				break;
-			case S_IFIFO:
-				if ( opt_p ) {
-					add_to_class(&pipe_class,entry->d_name);
-				}
-				break;
-			case S_IFLNK:
-				if ( opt_l ) {
-					add_to_class(&symlink_class,entry->d_name);
-				}
-				break;
-			case S_IFSOCK:
-				if ( opt_s ) {
-					add_to_class(&socket_class,entry->d_name);
-				}
-				break;
-			default:
-				fprintf(stderr,"Unexpected mode %o for %s\n",
-						filemode,entry->d_name);
-				if ( !anytypes ) {
-					add_to_class(&misc_class,entry->d_name);
-				} /* IF */
-			} /* end of SWITCH */
-		} /* IF lstat succeeded */
-		else {
-			system_error("lstat failed for \"%s\"",filepath);
-		} /* ELSE lstat failed */
-	} /* FOR loop over directory entries */
-	debug_print("close directory\n");
-	closedir(dirptr);
-	debug_print("directory is now closed\n");
-	if ( opt_o ) {
-		dump_class2(&regular_class);
-		dump_class2(&dir_class);
-		dump_class2(&char_class);
-		dump_class2(&block_class);
-		dump_class2(&pipe_class);
-		dump_class2(&symlink_class);
-		dump_class2(&socket_class);
-		dump_class2(&misc_class);
+	/* the stack holds the listings to be displayed , in reverse order */
+	max_stack = num_dirs + 16;
+	stack = (LISTING **)malloc(max_stack * sizeof(LISTING *));
+	if ( stack == NULL ) {
+		quit(1,"malloc failed for listings stack");
 	} /* IF */
-	else {
-		dump_class(&regular_class);
-		dump_class(&dir_class);
-		dump_class(&char_class);
-		dump_class(&block_class);
-		dump_class(&pipe_class);
-		dump_class(&symlink_class);
-		dump_class(&socket_class);
-		dump_class(&misc_class);
-	} /* ELSE */
+	for ( index = 0 ; index < num_dirs ; ++index ) {
+		stack[num_dirs-index-1] = new_listing(NULL,dir_args[index]);
+		queue_listing(&job,stack[num_dirs-index-1]);
+	} /* FOR */
+	stack_size = num_dirs;
+
+	if ( num_dirs == 1 && ! opt_R ) {
+		list = (DIRLIST *)malloc(sizeof(DIRLIST));
+		if ( list == NULL ) {
+			quit(1,"malloc failed for directory entries list");
+		} /* IF */
+		scan_directory(stack[0],list,job.metadata_threads);
+		stack[0]->done = 1;
+		free(list);
+		num_scanners = 0;
+	} /* IF */
+	for ( index = 0 ; index < num_scanners ; ++index ) {
+		errcode = pthread_create(&threads[index],NULL,scan_worker,&job);
+		if ( errcode != 0 ) {
+			errno = errcode;
+			quit(1,"pthread_create failed");
+		} /* IF */
+	} /* FOR */
+
+	errors = 0;
+	count = 0;
+	while ( stack_size > 0 ) {
+		listing = stack[--stack_size];
+		pthread_mutex_lock(&job.lock);
+		while ( ! listing->done ) {
+			pthread_cond_wait(&job.done_cond,&job.lock);
+		} /* WHILE */
+		if ( listing->num_subdirs > 0 && listing->children == NULL ) {
+			queue_children(&job,listing);
+		} /* IF */
+		pthread_mutex_unlock(&job.lock);
+
+		if ( (num_dirs > 1 || opt_R) && ! opt_0 ) {
+			if ( count++ > 0 ) {
+				out_write("\n",1);
+			} /* IF */
+			out_write(listing->dir_path,strlen(listing->dir_path));
+			out_write(":\n",2);
+		} /* IF */
+		errors += dump_listing(listing);
+
+		if ( stack_size + listing->num_subdirs > max_stack ) {
+			max_stack = (stack_size + listing->num_subdirs) * 2;
+			stack = (LISTING **)realloc(stack,max_stack * sizeof(LISTING *));
+			if ( stack == NULL ) {
+				quit(1,"realloc failed for listings stack");
+			} /* IF */
+		} /* IF */
+		for ( index = listing->num_subdirs - 1 ; index >= 0 ; --index ) {
+			stack[stack_size++] = listing->children[index];
+		} /* FOR */
+		pthread_mutex_lock(&job.lock);
+		job.pending -= 1;
+		pthread_mutex_unlock(&job.lock);
+		free_listing(listing);
+	} /* WHILE over listings in display order */
+	out_flush();
+
+	pthread_mutex_lock(&job.lock);
+	job.finished = 1;
+	pthread_cond_broadcast(&job.work_cond);
+	pthread_mutex_unlock(&job.lock);
+	for ( index = 0 ; index < num_scanners ; ++index ) {
+		pthread_join(threads[index],NULL);
+	} /* FOR */
 
-	exit(0);
+	exit(errors ? 1 : 0);
 } /* end of main */
@@ -0,0 +1,350 @@
+/*********************************************************************
+*
+* File      : lcbench.c
+*
+* Author    : Barry Kimelman
+*
+* Created   : October 19, 2026
+*
+* Purpose   : Benchmark the "lc" command against generated directories
+*             of mixed file types.
+*
+*********************************************************************/
+
+#include	<stdio.h>
+#include	<sys/types.h>
+#include	<sys/stat.h>
+#include	<sys/param.h>
+#include	<dirent.h>
+#include	<string.h>
+#include	<stdlib.h>
+#include	<unistd.h>
+#include	<fcntl.h>
+#include	<errno.h>
+#include	"bench.h"
+
+#define	EQ(s1,s2)	(strcmp(s1,s2)==0)
+
+#define	MAX_SIZES		16
+#define	MAX_COMBOS		64
+#define	MAX_REPEATS		100
+#define	MARKER_NAME		".lcbench"	/* records the size of a generated directory */
+
+static	char	*progname = NULL;
+static	char	*lc_path = "./lc";
+static	int		opt_k = 0 , opt_s = 0;
+static	int		num_repeats = 3;
+
+static	long	sizes[MAX_SIZES] = { 10000 , 100000 , 1000000 };
+static	int		num_sizes = 3;
+
+static	char	*combos[MAX_COMBOS] = { "" , "-o" , "-F" , "-n" , "-t" , "-S" ,
+					"-x" , "-U" , "-0" , "-U -T 8" , "-x -T 8" };
+static	int		num_combos = 11;
+static	int		combos_given = 0;
+
+extern	void	die() , quit() , system_error();
+
+/*********************************************************************
+*
+* Function  : usage
+*
+* Purpose   : Display program usage message.
+*
+* Inputs    : (none)
+*
+* Output    : Program usage message.
+*
+* Returns   : (nothing)
+*
+* Example   : usage();
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void usage()
+{
+	fprintf(stderr,"Usage : %s [-dks] [-l lc_path] [-n num_entries] [-o lc_options] "
+			"[-r repeats] base_dir [base_dir ...]\n",progname);
+	fprintf(stderr,"  -d  debug mode\n");
+	fprintf(stderr,"  -k  keep the generated directories\n");
+	fprintf(stderr,"  -s  also count system calls (traced run , not timed)\n");
+	fprintf(stderr,"  -n  directory size to test (repeatable , default 10000 100000 1000000)\n");
+	fprintf(stderr,"  -o  lc options to test (repeatable)\n");
+	fprintf(stderr,"Use a tmpfs (eg. /dev/shm) and a disk filesystem as the base_dirs.\n");
+
+	return;
+} /* end of usage */
+
+/*********************************************************************
+*
+* Function  : remove_directory
+*
+* Purpose   : Remove a generated directory and its entries.
+*
+* Inputs    : dirname - name of directory
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : remove_directory(dirname);
+*
+* Notes     : Generated directories are only one level deep , their
+*             subdirectories are empty.
+*
+*********************************************************************/
+
+void remove_directory(char *dirname)
+{
+	DIR		*dirptr;
+	struct dirent	*entry;
+	int		dir_fd;
+
+	dirptr = opendir(dirname);
+	if ( dirptr == NULL ) {
+		return;
+	} /* IF */
+	dir_fd = dirfd(dirptr);
+	while ( (entry = readdir(dirptr)) != NULL ) {
+		if ( EQ(entry->d_name,".") || EQ(entry->d_name,"..") ) {
+			continue;
+		} /* IF */
+		if ( unlinkat(dir_fd,entry->d_name,0) < 0 && errno == EISDIR ) {
+			unlinkat(dir_fd,entry->d_name,AT_REMOVEDIR);
+		} /* IF */
+	} /* WHILE */
+	closedir(dirptr);
+	if ( rmdir(dirname) < 0 ) {
+		system_error("rmdir failed for \"%s\"",dirname);
+	} /* IF */
+
+	return;
+} /* end of remove_directory */
+
+/*********************************************************************
+*
+* Function  : generate_directory
+*
+* Purpose   : Create a directory holding the specified number of
+*             entries of mixed types.
+*
+* Inputs    : dirname - name of directory
+*             num_entries - number of entries
+*
+* Output    : progress message
+*
+* Returns   : (nothing)
+*
+* Example   : generate_directory("/dev/shm/lcbench.10000",10000);
+*
+* Notes     : The entry types are mixed as described in make_entry() ,
+*             with names of varying length and case. An existing
+*             directory of the right size is reused.
+*
+*********************************************************************/
+
+void generate_directory(char *dirname, long num_entries)
+{
+	char	name[NAME_MAX+1] , path[MAXPATHLEN];
+	long	count;
+	int		dir_fd;
+	double	start;
+	static	char	*stems[] = { "data" , "Report" , "x" , "build_output_file" ,
+						"IMG" , "notes" , "a_rather_long_file_name_for_testing" };
+
+	snprintf(path,sizeof(path),"%s/%s",dirname,MARKER_NAME);
+	if ( read_marker(path) == num_entries ) {
+		debug_print("Reuse %s\n",dirname);
+		return;
+	} /* IF */
+	remove_directory(dirname);
+	if ( mkdir(dirname,0755) < 0 ) {
+		quit(1,"mkdir failed for \"%s\"",dirname);
+	} /* IF */
+	dir_fd = open(dirname,O_RDONLY | O_DIRECTORY);
+	if ( dir_fd < 0 ) {
+		quit(1,"open failed for \"%s\"",dirname);
+	} /* IF */
+
+	printf("Generating %s (%ld entries) ...",dirname,num_entries);
+	fflush(stdout);
+	start = now_seconds();
+	srandom(num_entries);
+	for ( count = 0 ; count < num_entries ; ++count ) {
+		snprintf(name,sizeof(name),"%s_%ld%s",stems[random() % 7],count,
+					(count % 3 == 0) ? ".txt" : "");
+		make_entry(dir_fd,name,count % 20);
+	} /* FOR */
+	close(dir_fd);
+
+	write_marker(path,num_entries);
+	printf(" %.1f seconds\n",now_seconds() - start);
+
+	return;
+} /* end of generate_directory */
+
+/*********************************************************************
+*
+* Function  : run_benchmark
+*
+* Purpose   : Time all the lc option combinations against one
+*             generated directory.
+*
+* Inputs    : dirname - name of directory
+*             num_entries - number of entries in directory
+*
+* Output    : one report line per option combination
+*
+* Returns   : (nothing)
+*
+* Example   : run_benchmark("/dev/shm/lcbench.10000",10000);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void run_benchmark(char *dirname, long num_entries)
+{
+	char	*args[MAX_ARGS] , buffer[1024] , syscalls[32];
+	double	times[MAX_REPEATS] , elapsed;
+	long	peak_rss , max_rss , count;
+	int		combo , repeat , failed;
+
+	printf("\n%s [%ld entries]\n",dirname,num_entries);
+	printf("%-16s %10s %10s %10s %12s\n","lc options","min (s)","median (s)",
+				"peak RSS Kb",opt_s ? "syscalls" : "");
+	for ( combo = 0 ; combo < num_combos ; ++combo ) {
+		build_args(args,lc_path,"-C 80",combos[combo],buffer,dirname);
+		max_rss = 0;
+		failed = 0;
+		for ( repeat = 0 ; repeat < num_repeats ; ++repeat ) {
+			elapsed = time_program(args,&peak_rss,NULL,NULL);
+			if ( elapsed < 0 ) {
+				failed = 1;
+				break;
+			} /* IF */
+			times[repeat] = elapsed;
+			if ( peak_rss > max_rss ) {
+				max_rss = peak_rss;
+			} /* IF */
+		} /* FOR */
+		if ( failed ) {
+			printf("%-16s lc failed\n",combos[combo][0] ? combos[combo] : "(none)");
+			continue;
+		} /* IF */
+		qsort(times,num_repeats,sizeof(double),compare_doubles);
+		syscalls[0] = '\0';
+		if ( opt_s ) {
+			count = count_syscalls(args);
+			snprintf(syscalls,sizeof(syscalls),"%ld",count);
+		} /* IF */
+		printf("%-16s %10.4f %10.4f %10ld %12s\n",
+				combos[combo][0] ? combos[combo] : "(none)",times[0],
+				times[num_repeats / 2],max_rss,syscalls);
+	} /* FOR */
+
+	return;
+} /* end of run_benchmark */
+
+/*********************************************************************
+*
+* Function  : main
+*
+* Purpose   : Benchmark lc against generated directories.
+*
+* Inputs    : int argc - number of arguments
+*             char *argv[] - list of arguments
+*
+* Output    : benchmark report
+*
+* Returns   : 0 --> success , 1 --> error
+*
+* Example   : lcbench -s -l ./lc /dev/shm /var/tmp
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+int main(int argc, char *argv[])
+{
+	int		c , errors , base , size , sizes_given;
+	char	dirname[MAXPATHLEN];
+
+	progname = argv[0];
+	errors = 0;
+	sizes_given = 0;
+	while ( (c = getopt(argc,argv,":dksl:n:o:r:")) != EOF ) {
+		switch ( c ) {
+		case 'd':
+			bench_debug = 1;
+			break;
+		case 'k':
+			opt_k = 1;
+			break;
+		case 's':
+			opt_s = 1;
+			break;
+		case 'l':
+			lc_path = optarg;
+			break;
+		case 'n':
+			if ( sizes_given >= MAX_SIZES ) {
+				die(1,"Too many directory sizes , limit is %d\n",MAX_SIZES);
+			} /* IF */
+			sizes[sizes_given++] = atol(optarg);
+			num_sizes = sizes_given;
+			break;
+		case 'o':
+			if ( ! combos_given ) {
+				num_combos = 0;
+				combos_given = 1;
+			} /* IF */
+			if ( num_combos >= MAX_COMBOS ) {
+				die(1,"Too many option combinations , limit is %d\n",MAX_COMBOS);
+			} /* IF */
+			combos[num_combos++] = optarg;
+			break;
+		case 'r':
+			num_repeats = atoi(optarg);
+			if ( num_repeats < 1 || num_repeats > MAX_REPEATS ) {
+				fprintf(stderr,"Repeats must be between 1 and %d\n",MAX_REPEATS);
+				errors += 1;
+			} /* IF */
+			break;
+		case '?':
+			fprintf(stderr,"Unknown option '%c'\n",optopt);
+			errors += 1;
+			break;
+		case ':':
+			fprintf(stderr,"Missing value for option '%c'\n",optopt);
+			errors += 1;
+			break;
+		} /* SWITCH */
+	} /* WHILE over optional args */
+	if ( errors || optind >= argc ) {
+		usage();
+		exit(1);
+	} /* IF */
+	if ( access(lc_path,X_OK) < 0 ) {
+		quit(1,"Can't execute \"%s\"",lc_path);
+	} /* IF */
+	if ( getenv("TERM") == NULL ) {
+		setenv("TERM","xterm",1);
+	} /* IF */
+
+	for ( base = optind ; base < argc ; ++base ) {
+		for ( size = 0 ; size < num_sizes ; ++size ) {
+			snprintf(dirname,sizeof(dirname),"%s/lcbench.%ld",argv[base],
+						sizes[size]);
+			generate_directory(dirname,sizes[size]);
+			run_benchmark(dirname,sizes[size]);
+			if ( ! opt_k ) {
+				remove_directory(dirname);
+			} /* IF */
+		} /* FOR over sizes */
+	} /* FOR over base directories */
+
+	exit(0);
+} /* end of main */
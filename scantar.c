@@ -25,10 +25,14 @@
 #include	<malloc.h>
 #include	<pwd.h>
 #include	<grp.h>
+#include	<sys/mman.h>
 #include	"mytar.h"
 
 #define	EQ(s1,s2)	(strcmp(s1,s2)==0)
 
+#define	INDEX_MAGIC		"STIDX001"
+#define	INDEX_SUFFIX	".idx"
+
 typedef	struct member_tag {
 	long		member_offset;
 	char		*member_name;
@@ -38,8 +42,25 @@ typedef	struct member_tag {
 	struct member_tag	*next;
 } MEMBER;
 
+typedef	struct index_header {
+	char		magic[8];
+	long long	archive_size;		/* the index is only used if these */
+	long long	archive_mtime_sec;	/* still match the archive */
+	long long	archive_mtime_nsec;
+	int			num_members;
+	int			num_slots;			/* a power of 2 */
+} INDEX_HEADER;		/* followed by the records , the slots and the names */
+
+typedef	struct index_record {
+	long long	header_offset;
+	long long	data_offset;
+	long long	data_size;
+	int			name_offset;		/* offset within the names */
+	int			name_length;
+} INDEX_RECORD;
+
 static	char	*progname = NULL;
-static	int		num_args , opt_d = 0;
+static	int		num_args , opt_d = 0 , opt_i = 0;
 static	union tar_header header1;
 static	struct stat	member_stats;
 
@@ -98,11 +119,181 @@ void debug_print(char *format,...)
 
 void usage()
 {
-	fprintf(stderr,"Usage : %s [-d] member_name string [tar_file]\n",progname);
+	fprintf(stderr,"Usage : %s [-di] member_name string [tar_file]\n",progname);
+	fprintf(stderr,"  -i  use (and if needed build) the member index tar_file%s\n",INDEX_SUFFIX);
 
 	return;
 } /* end of usage */
 
+/*********************************************************************
+*
+* Function  : octal_field
+*
+* Purpose   : Convert a numeric field of a tar header.
+*
+* Inputs    : char *field - the field
+*             int length - size of the field
+*
+* Output    : (none)
+*
+* Returns   : value of the field
+*
+* Example   : size = octal_field(header1.tar_buf.t_size,sizeof(header1.tar_buf.t_size));
+*
+* Notes     : The field need not be NUL terminated.
+*
+*********************************************************************/
+
+long long octal_field(char *field, int length)
+{
+	char	buffer[32];
+
+	if ( length >= sizeof(buffer) )
+		length = sizeof(buffer) - 1;
+	memcpy(buffer, field, length);
+	buffer[length] = '\0';
+
+	return(strtoll(buffer,NULL,8));
+} /* end of octal_field */
+
+/*********************************************************************
+*
+* Function  : read_member
+*
+* Purpose   : Read the header of the next archive member.
+*
+* Inputs    : int input_fd - file descriptor of open tar archive file
+*             long offset - offset of the header within the archive
+*
+* Output    : debugging message
+*
+* Returns   : pointer to new MEMBER , NULL at the end of the archive
+*
+* Example   : member = read_member(input_fd,offset);
+*
+* Notes     : The data of the member is not read.
+*
+*********************************************************************/
+
+MEMBER *read_member(int input_fd, long offset)
+{
+	int		num_bytes;
+	char	member_name[10+sizeof(header1.tar_buf.t_name)];
+	MEMBER	*member;
+
+	num_bytes = read(input_fd,&header1,TBLOCK_SIZE);
+	if ( num_bytes == 0 )
+		return(NULL);
+	if ( num_bytes != TBLOCK_SIZE )
+		quit(1,"Can't read header block from archive");
+
+	memset(member_name, 0, sizeof(member_name));
+	memcpy(member_name, header1.tar_buf.t_name, sizeof(header1.tar_buf.t_name));
+	if ( member_name[0] == '\0' )
+		return(NULL);
+	member = (MEMBER *)calloc(1,sizeof(MEMBER));
+	if ( member == NULL )
+		quit(1,"calloc failed");
+	member->member_name = strdup(member_name);
+	if ( member->member_name == NULL )
+		quit(1,"strdup failed");
+	member->member_offset = offset;
+
+	memset(&member_stats, 0, sizeof(member_stats));
+	member_stats.st_uid = octal_field(header1.tar_buf.t_uid,sizeof(header1.tar_buf.t_uid));
+	member_stats.st_gid = octal_field(header1.tar_buf.t_gid,sizeof(header1.tar_buf.t_gid));
+	member_stats.st_size = octal_field(header1.tar_buf.t_size,sizeof(header1.tar_buf.t_size));
+	member_stats.st_mtime = octal_field(header1.tar_buf.t_mtime,sizeof(header1.tar_buf.t_mtime));
+	member_stats.st_mode = octal_field(header1.tar_buf.t_mode,sizeof(header1.tar_buf.t_mode));
+	memcpy(&member->member_stats, &member_stats, sizeof(member_stats));
+
+	member->num_blocks = (member_stats.st_size + TBLOCK_SIZE - 1) / TBLOCK_SIZE;
+	member->member_size = member->num_blocks * TBLOCK_SIZE;
+
+	debug_print("file in archive is '%s' (%c) [%s] [0%o] , num_blocks = %d\n",member_name,
+					header1.tar_buf.t_typeflag,header1.tar_buf.t_magic,
+					member_stats.st_mode,member->num_blocks);
+
+	return(member);
+} /* end of read_member */
+
+/*********************************************************************
+*
+* Function  : free_member
+*
+* Purpose   : Free an archive member.
+*
+* Inputs    : MEMBER *member - the member
+*
+* Output    : (none)
+*
+* Returns   : (nothing)
+*
+* Example   : free_member(member);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void free_member(MEMBER *member)
+{
+	free(member->member_name);
+	free(member);
+
+	return;
+} /* end of free_member */
+
+/*********************************************************************
+*
+* Function  : search_member
+*
+* Purpose   : Display the lines of an archive member which contain
+*             the search argument.
+*
+* Inputs    : char *member_buffer - data of the member , with a spare
+*                                   byte at the end
+*             long long size - size of the data
+*             char *string - search argument
+*             char *archive_name - name of tar archive file
+*             char *member_name - name of archive member
+*
+* Output    : matching lines
+*
+* Returns   : (nothing)
+*
+* Example   : search_member(member_buffer,size,string,archive_name,member_name);
+*
+* Notes     : (none)
+*
+*********************************************************************/
+
+void search_member(char *member_buffer, long long size, char *string, char *archive_name,
+					char *member_name)
+{
+	char	*recptr1 , *recptr2;
+	int		count;
+
+	member_buffer[size] = '\0';
+	recptr1 = member_buffer;
+	count = 0;
+	while ( recptr1 != NULL ) {
+		recptr2 = strchr(recptr1,'\n');
+		if ( recptr2 != NULL )
+			*recptr2 = '\0';
+		if ( strstr(recptr1,string) != NULL ) {
+			if ( ++count == 1 )
+				printf("*** %s [%s] ***\n",archive_name,member_name);
+			printf("%s\n",recptr1);
+		} /* IF string found in archive member */
+		if ( recptr2 != NULL )
+			recptr1 = recptr2 + 1;
+		else
+			recptr1 = NULL;
+	} /* WHILE over records from archive member */
+
+	return;
+} /* end of search_member */
+
 /*********************************************************************
 *
 * Function  : process_archive
@@ -120,78 +311,33 @@ void usage()
 *
 * Example   : process_archive(member_name,string,0,"--");
 *
-* Notes     : (none)
+* Notes     : The archive is read from the start , so this also works
+*             for a pipe.
 *
 *********************************************************************/
 
 int process_archive(char *archive_member_name, char *string, int input_fd, char *archive_name)
 {
-	int		num_bytes , mode , num_blocks , count , found;
-	char	member_name[10+sizeof(header1.tar_buf.t_name)] , buffer[TBLOCK_SIZE];
+	int		num_bytes , count , found;
+	char	buffer[TBLOCK_SIZE] , *member_buffer;
 	MEMBER	*member;
-	unsigned char	*member_buffer , *recptr1 , *recptr2;
+	long	offset;
 
 	found = 0;
-	while ( 1 ) {
-		num_bytes = read(input_fd,&header1,TBLOCK_SIZE);
-		if ( num_bytes == 0 )
-			break;
-		if ( num_bytes != TBLOCK_SIZE )
-			quit(1,"Can't read header block from archive");
-
-		memset(member_name, 0, sizeof(member_name));
-		memcpy(member_name, header1.tar_buf.t_name, sizeof(header1.tar_buf.t_name));
-		if ( member_name[0] == '\0' )
-			break;
-		member = (MEMBER *)calloc(1,sizeof(MEMBER));
-		if ( member == NULL )
-			quit(1,"calloc failed");
-		member->member_name = strdup(member_name);
-		if ( member->member_name == NULL )
-			quit(1,"strdup failed");
-
-		memset(&member_stats, 0, sizeof(member_stats));
-		member_stats.st_uid = -1;
-		member_stats.st_gid = -1;
-		member_stats.st_size = -1;
-		sscanf(header1.tar_buf.t_uid,"%o",&member_stats.st_uid);
-		sscanf(header1.tar_buf.t_gid,"%o",&member_stats.st_gid);
-		sscanf(header1.tar_buf.t_size,"%o",&member_stats.st_size);
-		sscanf(header1.tar_buf.t_mtime,"%o",&member_stats.st_mtime);
-		sscanf(header1.tar_buf.t_mode,"%o",&mode);
-		member_stats.st_mode = mode;
-		memcpy(&member->member_stats, &member_stats, sizeof(member_stats));
-
-		num_blocks = (member_stats.st_size + TBLOCK_SIZE - 1) / TBLOCK_SIZE;
-		member->num_blocks = num_blocks;
-		member->member_size = num_blocks * TBLOCK_SIZE;
-
-		debug_print("file in archive is '%s' (%c) [%s] [0%o] , num_blocks = %d\n",member_name,
-						header1.tar_buf.t_typeflag,header1.tar_buf.t_magic,mode,member->num_blocks);
-		if ( EQ(member_name,archive_member_name) ) {
+	offset = 0;
+	while ( (member = read_member(input_fd,offset)) != NULL ) {
+		if ( EQ(member->member_name,archive_member_name) ) {
 			found = 1;
-			member_buffer = (unsigned char *)calloc(1,member_stats.st_size);
+			member_buffer = (char *)calloc(1,member->member_stats.st_size + 1);
 			if ( member_buffer == NULL )
-				quit(1,"calloc failed for %d bytes",member_stats.st_size);
-			num_bytes = read(input_fd,member_buffer,member_stats.st_size);
-			if ( num_bytes < member_stats.st_size )
-				quit(1,"Can't read %d bytes from archive",member_stats.st_size);
-			recptr1 = member_buffer;
-			count = 0;
-			while ( recptr1 != NULL ) {
-				recptr2 = (unsigned char *)strchr((char *)recptr1,'\n');
-				if ( recptr2 != NULL )
-					*recptr2 = '\0';
-				if ( strstr((char *)recptr1,string) != NULL ) {
-					if ( ++count == 1 )
-						printf("*** %s [%s] ***\n",archive_name,archive_member_name);
-					printf("%s\n",recptr1);
-				} /* IF string found in archive member */
-				if ( recptr2 != NULL )
-					recptr1 = recptr2 + 1;
-				else
-					recptr1 = NULL;
-			} /* WHILE over records from archive member */
+				quit(1,"calloc failed for %lld bytes",(long long)member->member_stats.st_size);
+			num_bytes = read(input_fd,member_buffer,member->member_stats.st_size);
+			if ( num_bytes < member->member_stats.st_size )
+				quit(1,"Can't read %lld bytes from archive",(long long)member->member_stats.st_size);
+			search_member(member_buffer,member->member_stats.st_size,string,archive_name,
+							archive_member_name);
+			free(member_buffer);
+			free_member(member);
 			break;  /* get out of big loop over archive members */
 		} /* IF */
 
@@ -200,12 +346,374 @@ int process_archive(char *archive_member_name, char *string, int input_fd, char
 			if ( num_bytes != TBLOCK_SIZE )
 				quit(1,"Can't read data block from archive");
 		} /* FOR */
-
+		offset += TBLOCK_SIZE + member->member_size;
+		free_member(member);
 	} /* WHILE more data to be processed */
 
 	return(found);
 } /* end of process_archive */
 
+/*********************************************************************
+*
+* Function  : name_hash
+*
+* Purpose   : Compute the hash value of a member name.
+*
+* Inputs    : char *name - the name
+*
+* Output    : (none)
+*
+* Returns   : hash value
+*
+* Example   : slot = name_hash(name) & (num_slots - 1);
+*
+* Notes     : FNV-1a. The value is stored in index files , so it must
+*             not change.
+*
+*********************************************************************/
+
+unsigned int name_hash(char *name)
+{
+	unsigned int	hash;
+
+	for ( hash = 2166136261U ; *name ; ++name ) {
+		hash ^= (unsigned char)*name;
+		hash *= 16777619U;
+	} /* FOR */
+
+	return(hash);
+} /* end of name_hash */
+
+/*********************************************************************
+*
+* Function  : scan_archive
+*
+* Purpose   : Read the headers of all the members of an archive.
+*
+* Inputs    : int tar_fd - file descriptor of open tar archive file
+*             int *num_members - to receive the number of members
+*
+* Output    : (none)
+*
+* Returns   : list of members in archive order
+*
+* Example   : list = scan_archive(tar_fd,&num_members);
+*
+* Notes     : The data blocks are skipped with lseek() rather than read.
+*
+*********************************************************************/
+
+MEMBER *scan_archive(int tar_fd, int *num_members)
+{
+	MEMBER	*list , **tail , *member;
+	long	offset;
+
+	list = NULL;
+	tail = &list;
+	*num_members = 0;
+	offset = 0;
+	if ( lseek(tar_fd,0,SEEK_SET) < 0 )
+		quit(1,"lseek failed on archive");
+	while ( (member = read_member(tar_fd,offset)) != NULL ) {
+		*tail = member;
+		tail = &member->next;
+		*num_members += 1;
+		offset += TBLOCK_SIZE + member->member_size;
+		if ( lseek(tar_fd,offset,SEEK_SET) < 0 )
+			quit(1,"lseek failed on archive");
+	} /* WHILE */
+
+	return(list);
+} /* end of scan_archive */
+
+/*********************************************************************
+*
+* Function  : write_index
+*
+* Purpose   : Write the member index of an archive.
+*
+* Inputs    : char *index_name - name of index file
+*             struct stat *archive_stats - status of the archive
+*             MEMBER *list - members of the archive
+*             int num_members - number of members
+*
+* Output    : a warning if the index can't be written
+*
+* Returns   : (nothing)
+*
+* Example   : write_index(index_name,&archive_stats,list,num_members);
+*
+* Notes     : The index is written under a temporary name and renamed ,
+*             so a reader never sees a partial index. When a name occurs
+*             more than once the first member is indexed , as that is
+*             the one a sequential search finds.
+*
+*********************************************************************/
+
+void write_index(char *index_name, struct stat *archive_stats, MEMBER *list, int num_members)
+{
+	INDEX_HEADER	index_header;
+	INDEX_RECORD	*records , *record;
+	int		*slots , index , slot , names_size , fd;
+	char	*names , temp_name[MAXPATHLEN];
+	MEMBER	*member;
+	FILE	*fp;
+
+	memset(&index_header, 0, sizeof(index_header));
+	memcpy(index_header.magic, INDEX_MAGIC, sizeof(index_header.magic));
+	index_header.archive_size = archive_stats->st_size;
+	index_header.archive_mtime_sec = archive_stats->st_mtim.tv_sec;
+	index_header.archive_mtime_nsec = archive_stats->st_mtim.tv_nsec;
+	for ( index_header.num_slots = 16 ; index_header.num_slots < 2 * num_members ; )
+		index_header.num_slots *= 2;
+
+	records = (INDEX_RECORD *)calloc(num_members + 1,sizeof(INDEX_RECORD));
+	slots = (int *)calloc(index_header.num_slots,sizeof(int));
+	names_size = 0;
+	for ( member = list ; member != NULL ; member = member->next )
+		names_size += strlen(member->member_name) + 1;
+	names = (char *)malloc(names_size + 1);
+	if ( records == NULL || slots == NULL || names == NULL )
+		quit(1,"malloc failed for index of %d members",num_members);
+
+	names_size = 0;
+	for ( member = list ; member != NULL ; member = member->next ) {
+		slot = name_hash(member->member_name) & (index_header.num_slots - 1);
+		while ( slots[slot] != 0 &&
+					! EQ(names + records[slots[slot] - 1].name_offset,member->member_name) )
+			slot = (slot + 1) & (index_header.num_slots - 1);
+		if ( slots[slot] != 0 )
+			continue;  /* a later member of the same name */
+		index = index_header.num_members++;
+		record = &records[index];
+		record->header_offset = member->member_offset;
+		record->data_offset = member->member_offset + TBLOCK_SIZE;
+		record->data_size = member->member_stats.st_size;
+		record->name_offset = names_size;
+		record->name_length = strlen(member->member_name);
+		strcpy(names + names_size,member->member_name);
+		names_size += record->name_length + 1;
+		slots[slot] = index + 1;
+	} /* FOR over members */
+
+	snprintf(temp_name,sizeof(temp_name),"%s.XXXXXX",index_name);
+	fd = mkstemp(temp_name);
+	if ( fd < 0 ) {
+		fprintf(stderr,"Can't create index \"%s\" : %s\n",temp_name,strerror(errno));
+	} /* IF */
+	else {
+		fchmod(fd,0644);
+		fp = fdopen(fd,"w");
+		if ( fp == NULL ||
+				fwrite(&index_header,sizeof(index_header),1,fp) != 1 ||
+				fwrite(records,sizeof(INDEX_RECORD),index_header.num_members,fp) !=
+							index_header.num_members ||
+				fwrite(slots,sizeof(int),index_header.num_slots,fp) != index_header.num_slots ||
+				fwrite(names,1,names_size,fp) != names_size ||
+				fclose(fp) != 0 || rename(temp_name,index_name) < 0 ) {
+			fprintf(stderr,"Can't write index \"%s\" : %s\n",index_name,strerror(errno));
+			unlink(temp_name);
+		} /* IF */
+		else {
+			debug_print("Wrote index '%s' of %d members\n",index_name,index_header.num_members);
+		} /* ELSE */
+	} /* ELSE */
+	free(records);
+	free(slots);
+	free(names);
+
+	return;
+} /* end of write_index */
+
+/*********************************************************************
+*
+* Function  : load_index
+*
+* Purpose   : Map the member index of an archive.
+*
+* Inputs    : char *index_name - name of index file
+*             struct stat *archive_stats - status of the archive
+*             size_t *index_size - to receive the size of the mapping
+*
+* Output    : (none)
+*
+* Returns   : address of the mapped index , NULL if it is missing ,
+*             damaged or out of date
+*
+* Example   : index_map = load_index(index_name,&archive_stats,&index_size);
+*
+* Notes     : The index is out of date if the size or the modification
+*             time of the archive has changed.
+*
+*********************************************************************/
+
+char *load_index(char *index_name, struct stat *archive_stats, size_t *index_size)
+{
+	int		fd;
+	struct stat	index_stats;
+	char	*index_map;
+	INDEX_HEADER	*index_header;
+	size_t	min_size;
+
+	fd = open(index_name,O_RDONLY);
+	if ( fd < 0 )
+		return(NULL);
+	if ( fstat(fd,&index_stats) < 0 || index_stats.st_size < sizeof(INDEX_HEADER) ) {
+		close(fd);
+		return(NULL);
+	} /* IF */
+	index_map = mmap(NULL,index_stats.st_size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if ( index_map == MAP_FAILED )
+		return(NULL);
+
+	index_header = (INDEX_HEADER *)index_map;
+	min_size = sizeof(INDEX_HEADER) + (size_t)index_header->num_members * sizeof(INDEX_RECORD) +
+				(size_t)index_header->num_slots * sizeof(int);
+	if ( memcmp(index_header->magic,INDEX_MAGIC,sizeof(index_header->magic)) != 0 ||
+			index_header->num_members < 0 || index_header->num_slots <= 0 ||
+			(index_header->num_slots & (index_header->num_slots - 1)) != 0 ||
+			index_stats.st_size < min_size ||
+			index_header->archive_size != archive_stats->st_size ||
+			index_header->archive_mtime_sec != archive_stats->st_mtim.tv_sec ||
+			index_header->archive_mtime_nsec != archive_stats->st_mtim.tv_nsec ) {
+		debug_print("Index '%s' is out of date\n",index_name);
+		munmap(index_map,index_stats.st_size);
+		return(NULL);
+	} /* IF */
+	*index_size = index_stats.st_size;
+
+	return(index_map);
+} /* end of load_index */
+
+/*********************************************************************
+*
+* Function  : find_in_index
+*
+* Purpose   : Look up a member in a mapped index.
+*
+* Inputs    : char *index_map - the mapped index
+*             size_t index_size - size of the mapping
+*             char *member_name - name of archive member
+*
+* Output    : (none)
+*
+* Returns   : pointer to record of member , NULL if not found
+*
+* Example   : record = find_in_index(index_map,index_size,member_name);
+*
+* Notes     : Only the slots probed and the names compared are
+*             touched , so a lookup costs the same for any size of
+*             archive.
+*
+*********************************************************************/
+
+INDEX_RECORD *find_in_index(char *index_map, size_t index_size, char *member_name)
+{
+	INDEX_HEADER	*index_header;
+	INDEX_RECORD	*records , *record;
+	int		*slots , slot , length , probes;
+	char	*names;
+	size_t	names_size;
+
+	index_header = (INDEX_HEADER *)index_map;
+	records = (INDEX_RECORD *)(index_header + 1);
+	slots = (int *)(records + index_header->num_members);
+	names = (char *)(slots + index_header->num_slots);
+	names_size = index_map + index_size - names;
+	length = strlen(member_name);
+
+	slot = name_hash(member_name) & (index_header->num_slots - 1);
+	for ( probes = 0 ; probes < index_header->num_slots && slots[slot] != 0 ; ++probes ) {
+		if ( slots[slot] < 0 || slots[slot] > index_header->num_members )
+			return(NULL);
+		record = &records[slots[slot] - 1];
+		if ( record->name_length == length && record->name_offset >= 0 &&
+					record->name_offset + length < names_size &&
+					memcmp(names + record->name_offset,member_name,length) == 0 )
+			return(record);
+		slot = (slot + 1) & (index_header->num_slots - 1);
+	} /* FOR */
+
+	return(NULL);
+} /* end of find_in_index */
+
+/*********************************************************************
+*
+* Function  : indexed_lookup
+*
+* Purpose   : Search an archive member found through the member index.
+*
+* Inputs    : char *member_name - name of archive member
+*             char *string - search argument
+*             int tar_fd - file descriptor of open tar archive file
+*             char *archive_name - name of tar archive file
+*
+* Output    : matching lines
+*
+* Returns   : 1 if the member was found , else 0
+*
+* Example   : status = indexed_lookup(member_name,string,tar_fd,filename);
+*
+* Notes     : A missing or out of date index is rebuilt from one pass
+*             over the headers. The member is then read with a single
+*             pread().
+*
+*********************************************************************/
+
+int indexed_lookup(char *member_name, char *string, int tar_fd, char *archive_name)
+{
+	char	index_name[MAXPATHLEN] , *index_map , *member_buffer;
+	struct stat	archive_stats;
+	size_t	index_size;
+	INDEX_RECORD	*record;
+	MEMBER	*list , *member;
+	int		num_members;
+	long long	data_offset , data_size;
+
+	if ( fstat(tar_fd,&archive_stats) < 0 )
+		quit(1,"fstat failed for \"%s\"",archive_name);
+	snprintf(index_name,sizeof(index_name),"%s%s",archive_name,INDEX_SUFFIX);
+
+	index_map = load_index(index_name,&archive_stats,&index_size);
+	if ( index_map != NULL ) {
+		record = find_in_index(index_map,index_size,member_name);
+		if ( record == NULL ) {
+			munmap(index_map,index_size);
+			return(0);
+		} /* IF */
+		data_offset = record->data_offset;
+		data_size = record->data_size;
+		munmap(index_map,index_size);
+	} /* IF index is current */
+	else {
+		list = scan_archive(tar_fd,&num_members);
+		write_index(index_name,&archive_stats,list,num_members);
+		data_offset = -1;
+		data_size = 0;
+		for ( member = list ; member != NULL ; member = list ) {
+			if ( data_offset < 0 && EQ(member->member_name,member_name) ) {
+				data_offset = member->member_offset + TBLOCK_SIZE;
+				data_size = member->member_stats.st_size;
+			} /* IF */
+			list = member->next;
+			free_member(member);
+		} /* FOR */
+		if ( data_offset < 0 )
+			return(0);
+	} /* ELSE */
+
+	member_buffer = (char *)malloc(data_size + 1);
+	if ( member_buffer == NULL )
+		quit(1,"malloc failed for %lld bytes",data_size);
+	if ( pread(tar_fd,member_buffer,data_size,data_offset) != data_size )
+		quit(1,"Can't read %lld bytes from archive",data_size);
+	search_member(member_buffer,data_size,string,archive_name,member_name);
+	free(member_buffer);
+
+	return(1);
+} /* end of indexed_lookup */
+
 /*********************************************************************
 *
 * Function  : main
@@ -232,11 +740,14 @@ int main(int argc, char *argv[])
 
 	progname = argv[0];
 	errors = 0;
-	while ( (c = getopt(argc,argv,":d")) != EOF ) {
+	while ( (c = getopt(argc,argv,":di")) != EOF ) {
 		switch ( c ) {
 		case 'd':
 			opt_d = 1;
 			break;
+		case 'i':
+			opt_i = 1;
+			break;
 		case '?':
 			errors = 1;
 			break;
@@ -255,6 +766,9 @@ int main(int argc, char *argv[])
 	member_name = argv[optind++];
 	string = argv[optind++];
 	if ( optind >= argc ) {
+		if ( opt_i ) {
+			fprintf(stderr,"-i needs a tar_file , reading the archive from stdin\n");
+		} /* IF */
 		status = process_archive(member_name,string,0,"--");
 	} /* IF */
 	else {
@@ -262,7 +776,12 @@ int main(int argc, char *argv[])
 		tar_fd = open(filename,O_RDONLY);
 		if ( tar_fd < 0 )
 			quit(1,"open failed for \"%s\"",filename);
-		status = process_archive(member_name,string,tar_fd,filename);
+		if ( opt_i ) {
+			status = indexed_lookup(member_name,string,tar_fd,filename);
+		} /* IF */
+		else {
+			status = process_archive(member_name,string,tar_fd,filename);
+		} /* ELSE */
 		close(tar_fd);
 	} /* ELSE */
 
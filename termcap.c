@@ -46,6 +46,9 @@ static  char    *termtype;      /* terminal type (eg. VT100) */
 
 static  int     onechar(char); /* used to be a char parameter */
 
+static	char	*capture_ptr;	/* used by capture_char() */
+static	int		capture_room;
+
 int     tty_num_rows = 24 , tty_num_cols = 80;
 
 void    move_cursor_home() , move_cursor();
@@ -630,6 +633,60 @@ void standout_print(char *fmt,...)
     return;
 } /* end of standout_print */
 
+/*
+* Function:     capture_char
+*
+* Purpose:      Store one character of a capability string into the
+*               buffer set up by get_standout_sequences().
+*
+* Parameters:   ch - the character to be stored.
+*
+* Returns:      zero
+*
+* Example:      tputs(so,1,capture_char);
+*/
+
+static int capture_char(int ch)
+{
+    if ( capture_room > 1 ) {
+        *capture_ptr++ = ch;
+        capture_room -= 1;
+    } /* IF */
+    return(0);
+} /* end of capture_char */
+
+/*
+* Function:     get_standout_sequences
+*
+* Purpose:      Render the start and end standout sequences into
+*               buffers so that callers doing their own buffered
+*               output do not have to flush around each tputs().
+*
+* Parameters:   start - buffer to receive the start standout sequence
+*               end - buffer to receive the end standout sequence
+*               size - size of each buffer
+*
+* Returns:      nothing
+*
+* Example:      get_standout_sequences(so_buf,se_buf,sizeof(so_buf));
+*/
+
+void get_standout_sequences(char *start, char *end, int size)
+{
+    capture_ptr = start;
+    capture_room = size;
+    if ( so != NULL )
+        tputs(so,1,capture_char);
+    *capture_ptr = '\0';
+
+    capture_ptr = end;
+    capture_room = size;
+    if ( se != NULL )
+        tputs(se,1,capture_char);
+    *capture_ptr = '\0';
+    return;
+} /* end of get_standout_sequences */
+
 /*
 * Function:     underline_mode
 *